@@ -0,0 +1,91 @@
+#include "AccumulationBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * the perceived brightness of a linear rgb color
+ */
+static auto luminance(const Vec3 &color) -> float
+{
+    return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+void AccumulationBuffer::reset(const std::vector<Tile> &tiles)
+{
+    m_Tiles = tiles;
+    m_TileOffsets.resize(tiles.size());
+    m_TileSamples.assign(tiles.size(), 0);
+    m_TileErrors.assign(tiles.size(), std::numeric_limits<float>::infinity());
+    m_TileLocks = std::make_unique<std::mutex[]>(tiles.size());
+
+    size_t numPixels = 0;
+    for (const Tile &tile : tiles)
+    {
+        m_TileOffsets[tile.index] = numPixels;
+        numPixels += static_cast<size_t>(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    }
+
+    m_Sums.assign(numPixels, Vec3());
+    m_SumsOfSquares.assign(numPixels, 0.0f);
+}
+
+void AccumulationBuffer::addTile(const Tile &tile, const Vec3 *colors)
+{
+    size_t numPixels = static_cast<size_t>(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    Vec3 *sums = m_Sums.data() + m_TileOffsets[tile.index];
+    float *sumsOfSquares = m_SumsOfSquares.data() + m_TileOffsets[tile.index];
+
+    std::lock_guard<std::mutex> lock(m_TileLocks[tile.index]);
+    for (size_t i = 0; i < numPixels; i++)
+    {
+        sums[i] += colors[i];
+
+        float lum = luminance(colors[i]);
+        sumsOfSquares[i] += lum * lum;
+    }
+
+    unsigned int numSamples = ++m_TileSamples[tile.index];
+    if (numSamples < 2)
+    {
+        return;
+    }
+
+    // unbiased sample variance of each pixel's luminance, divided by n for the variance of the mean
+    float n = static_cast<float>(numSamples);
+    float sumOfSquaredErrors = 0.0f;
+    for (size_t i = 0; i < numPixels; i++)
+    {
+        float mean = luminance(sums[i]) / n;
+        float variance = std::max(sumsOfSquares[i] / n - mean * mean, 0.0f) * n / (n - 1.0f);
+        float relativeError = sqrtf(variance / n) / std::max(mean, 0.01f);
+        sumOfSquaredErrors += relativeError * relativeError;
+    }
+
+    m_TileErrors[tile.index] = sqrtf(sumOfSquaredErrors / static_cast<float>(numPixels));
+}
+
+void AccumulationBuffer::resolveTile(unsigned int tileIndex, PixelBuffer &pixelBuffer)
+{
+    const Tile &tile = m_Tiles[tileIndex];
+    const Vec3 *sums = m_Sums.data() + m_TileOffsets[tileIndex];
+
+    std::lock_guard<std::mutex> lock(m_TileLocks[tileIndex]);
+    unsigned int numSamples = m_TileSamples[tileIndex];
+    if (numSamples == 0)
+    {
+        return;
+    }
+
+    // one division per tile, the pixels are scaled by the reciprocal
+    float scale = 1.0f / static_cast<float>(numSamples);
+    for (int y = tile.y0; y < tile.y1; y++)
+    {
+        for (int x = tile.x0; x < tile.x1; x++)
+        {
+            Vec3 sum = *sums++;
+            pixelBuffer.setPixel(x, y, sum * scale, numSamples);
+        }
+    }
+}
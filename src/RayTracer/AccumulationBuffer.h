@@ -0,0 +1,75 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "TileScheduler.h"
+#include "Utils/Vec3.h"
+#include "Window/PixelBuffer.h"
+
+/**
+ * \brief Sums the samples of every pixel, stored tile by tile.
+ *
+ * The radiance sums of a tile are contiguous in memory and each tile keeps its own sample count. A worker renders a
+ * whole tile into its own scratch colors and adds them in one go, so the only lock taken is one uncontended tile lock
+ * per tile and pass. The averages are only computed when the buffer is resolved into the pixel buffer for display.
+ *
+ * The sum of squared luminance of every pixel is kept as well so each tile can estimate how noisy its average still
+ * is, which lets the adaptive sampler send samples to the noisiest tiles first.
+ */
+class AccumulationBuffer
+{
+  public:
+    /**
+     * \brief Allocates zeroed sums for every tile.
+     *
+     * Must not be called while samples are added or resolved.
+     *
+     * \param tiles The tiles of the pixel buffer, indexed by Tile::index.
+     */
+    void reset(const std::vector<Tile> &tiles);
+
+    /**
+     * \brief Adds one sample to every pixel of a tile.
+     *
+     * \param tile The tile that was rendered.
+     * \param colors The colors of the tile's pixels, row by row.
+     */
+    void addTile(const Tile &tile, const Vec3 *colors);
+
+    /**
+     * \brief Writes the average color of every pixel of a tile to the pixel buffer.
+     *
+     * \param tileIndex The index of the tile to resolve.
+     * \param pixelBuffer The display buffer to write to.
+     */
+    void resolveTile(unsigned int tileIndex, PixelBuffer &pixelBuffer);
+
+    /**
+     * \brief The estimated relative error of a tile's average.
+     *
+     * The root mean square over the tile's pixels of the standard error of the pixel's mean luminance divided by that
+     * mean. Tiles with fewer than two samples have an infinite error.
+     *
+     * \param tileIndex The index of the tile.
+     */
+    auto inline getTileError(unsigned int tileIndex) const -> float
+    {
+        return m_TileErrors[tileIndex];
+    }
+
+    auto inline getNumTiles() const -> unsigned int
+    {
+        return static_cast<unsigned int>(m_Tiles.size());
+    }
+
+  private:
+    std::vector<Tile> m_Tiles{};
+    std::vector<size_t> m_TileOffsets{};
+    std::vector<unsigned int> m_TileSamples{};
+    std::vector<float> m_TileErrors{};
+    std::unique_ptr<std::mutex[]> m_TileLocks{};
+
+    std::vector<Vec3> m_Sums{};
+    std::vector<float> m_SumsOfSquares{};
+};
@@ -0,0 +1,110 @@
+#include "Bsdf.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * the mean of a color's channels, used to weigh the lobes against each other
+ */
+static auto average(const Vec3 &color) -> float
+{
+    return (color.x + color.y + color.z) / 3.0f;
+}
+
+Bsdf::Bsdf(const Material &mat, Vec3 normal, const Vec3 &wo)
+    : m_Normal(normal), m_SpecularExponent(mat.specularExponent),
+      m_Mirror(std::min(std::max(mat.reflection, 0.0f), 1.0f))
+{
+    m_Normal.normalize();
+    if (m_Normal.dot(wo) < 0.0f)
+    {
+        m_Normal = m_Normal * -1.0f;
+    }
+    m_Reflected = m_Normal * (2.0f * m_Normal.dot(wo)) - wo;
+
+    m_Diffuse = mat.diffuse * (1.0f - m_Mirror);
+    m_Specular = mat.specular * (1.0f - m_Mirror);
+
+    float diffuseWeight = std::max(average(m_Diffuse), 0.0f);
+    float specularWeight = std::max(average(m_Specular), 0.0f);
+    float totalWeight = diffuseWeight + specularWeight + m_Mirror;
+    if (totalWeight > 0.0f)
+    {
+        m_DiffuseProb = diffuseWeight / totalWeight;
+        m_SpecularProb = specularWeight / totalWeight;
+        m_MirrorProb = m_Mirror / totalWeight;
+    }
+}
+
+auto Bsdf::evaluate(const Vec3 &wi) const -> Vec3
+{
+    float cosTheta = m_Normal.dot(wi);
+    if (cosTheta <= 0.0f)
+    {
+        return Vec3();
+    }
+
+    // the normalized Phong lobe reflects at most the specular color
+    float cosAlpha = std::max(m_Reflected.dot(wi), 0.0f);
+    float glossy = (m_SpecularExponent + 2.0f) / (2.0f * PI) * powf(cosAlpha, m_SpecularExponent);
+
+    return (m_Diffuse * (1.0f / PI) + m_Specular * glossy) * cosTheta;
+}
+
+auto Bsdf::pdf(const Vec3 &wi) const -> float
+{
+    float cosTheta = m_Normal.dot(wi);
+    if (cosTheta <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float cosAlpha = std::max(m_Reflected.dot(wi), 0.0f);
+    float diffusePdf = cosTheta / PI;
+    float specularPdf = (m_SpecularExponent + 1.0f) / (2.0f * PI) * powf(cosAlpha, m_SpecularExponent);
+
+    return m_DiffuseProb * diffusePdf + m_SpecularProb * specularPdf;
+}
+
+auto Bsdf::sample(float uLobe, float u1, float u2, BsdfSample &sample) const -> bool
+{
+    if (m_DiffuseProb + m_SpecularProb + m_MirrorProb <= 0.0f)
+    {
+        return false;
+    }
+
+    if (uLobe < m_MirrorProb)
+    {
+        sample.dir = m_Reflected;
+        sample.weight = Vec3(m_Mirror / m_MirrorProb);
+        sample.pdf = m_MirrorProb;
+        sample.isMirror = true;
+        return true;
+    }
+
+    float phi = 2.0f * PI * u2;
+    if (uLobe < m_MirrorProb + m_DiffuseProb)
+    {
+        // cosine weighted hemisphere around the normal
+        float sinTheta = sqrtf(u1);
+        sample.dir = toWorld(m_Normal, sinTheta * cosf(phi), sinTheta * sinf(phi), sqrtf(1.0f - u1));
+    }
+    else
+    {
+        // cosine power lobe around the mirror direction
+        float cosAlpha = powf(u1, 1.0f / (m_SpecularExponent + 1.0f));
+        float sinAlpha = sqrtf(std::max(0.0f, 1.0f - cosAlpha * cosAlpha));
+        sample.dir = toWorld(m_Reflected, sinAlpha * cosf(phi), sinAlpha * sinf(phi), cosAlpha);
+    }
+
+    // the diffuse and glossy lobes overlap, so the density of the direction is that of both together
+    sample.pdf = pdf(sample.dir);
+    sample.isMirror = false;
+    if (sample.pdf <= 0.0f)
+    {
+        return false;
+    }
+
+    sample.weight = evaluate(sample.dir) * (1.0f / sample.pdf);
+    return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "Scene/Material.h"
+#include "Utils/Vec3.h"
+
+/**
+ * \brief A direction picked by Bsdf::sample.
+ */
+struct BsdfSample
+{
+    /**
+     * \brief The unit direction the path continues in.
+     */
+    Vec3 dir;
+
+    /**
+     * \brief The bsdf times the cosine of the direction divided by the density it was picked with, the factor the
+     * path throughput is multiplied with.
+     */
+    Vec3 weight;
+
+    /**
+     * \brief The solid angle density the direction was picked with, only meaningful if isMirror is false.
+     */
+    float pdf = 0.0f;
+
+    /**
+     * \brief True if the direction is the perfect mirror reflection, which no light sample can find.
+     */
+    bool isMirror = false;
+};
+
+/**
+ * \brief The scattering of light at one point of a surface.
+ *
+ * Built from a material, it has three lobes. A Lambertian diffuse lobe is weighted by the diffuse color. A glossy
+ * Phong lobe around the mirror direction has its sharpness set by the specular exponent. A perfect mirror lobe is
+ * weighted by the reflection coefficient. The diffuse and glossy lobes only get the light the mirror does not
+ * reflect. The surface is two sided, so the normal is flipped to the side the light leaves towards.
+ *
+ * Directions are sampled by picking a lobe with a probability that follows its brightness and sampling that lobe's
+ * shape, cosine weighted for the diffuse lobe and along the Phong lobe for the glossy one.
+ */
+class Bsdf
+{
+  public:
+    /**
+     * \brief Creates the bsdf of a surface point.
+     *
+     * \param mat The material of the surface.
+     * \param normal The surface normal at the point.
+     * \param wo The unit direction from the point towards where the light leaves, the reverse of the incoming ray.
+     */
+    Bsdf(const Material &mat, Vec3 normal, const Vec3 &wo);
+
+    /**
+     * \brief The bsdf of the diffuse and glossy lobes times the cosine of a direction to the normal.
+     *
+     * \param wi The unit direction light arrives from.
+     */
+    auto evaluate(const Vec3 &wi) const -> Vec3;
+
+    /**
+     * \brief The solid angle density with which sample picks a direction through the diffuse and glossy lobes.
+     *
+     * \param wi The unit direction light arrives from.
+     */
+    auto pdf(const Vec3 &wi) const -> float;
+
+    /**
+     * \brief Picks the direction the path continues in.
+     *
+     * \param uLobe A uniform random number in [0, 1) that picks the lobe.
+     * \param u1 A uniform random number in [0, 1) for the direction.
+     * \param u2 A uniform random number in [0, 1) for the direction.
+     * \param sample Set to the picked direction and its weight.
+     * \returns False if the surface reflects no light or the direction points into the surface.
+     */
+    auto sample(float uLobe, float u1, float u2, BsdfSample &sample) const -> bool;
+
+    /**
+     * \brief The surface normal on the side of wo.
+     */
+    auto inline getNormal() const -> const Vec3 &
+    {
+        return m_Normal;
+    }
+
+  private:
+    Vec3 m_Normal;
+    Vec3 m_Reflected;
+
+    Vec3 m_Diffuse;
+    Vec3 m_Specular;
+    float m_SpecularExponent;
+    float m_Mirror;
+
+    float m_DiffuseProb = 0.0f;
+    float m_SpecularProb = 0.0f;
+    float m_MirrorProb = 0.0f;
+};
@@ -1,7 +1,6 @@
 #pragma once
 #include "RayTracer/Ray.h"
 #include "Utils/Vec3.h"
-#include <string>
 
 /**
  * \brief The result of a ray object intersection.
@@ -42,11 +41,12 @@ struct Hit
     Vec3 normal{};
 
     /**
-     * \brief The name of the material of the scene object that intersected the ray.
+     * \brief The material of the scene object that intersected the ray.
      *
-     * The string identifier of the material of the scene object that the ray first intersected with.
+     * The index into the scene's material table of the material of the scene object that the ray first intersected
+     * with.
      */
-    std::string materialName;
+    unsigned int materialId = 0;
 
     /**
      * \brief The color of the hit calculated by the ray tracer.
@@ -65,7 +65,7 @@ struct Hit
      * \brief Creates a new Hit object.
      *
      * Creates a new Hit object where isHit is set to false. Time is set to INFINITY. All Vector3 parameters are set to
-     * (0, 0, 0) and materialName is set to an empty string.
+     * (0, 0, 0) and materialId is set to 0.
      */
     Hit() : time(INFINITY)
     {
@@ -1,16 +1,33 @@
 #include "RayTracer.h"
 
+#include <algorithm>
 #include <cmath>
 
+/**
+ * the weight of a sample taken with one strategy that could also have been taken with another, the densities are
+ * scaled by the number of samples each strategy takes (Veach, "Robust Monte Carlo Methods for Light Transport
+ * Simulation", chapter 9)
+ */
+static auto powerHeuristic(float pdf, float otherPdf) -> float
+{
+    float pdf2 = pdf * pdf;
+    float sum = pdf2 + otherPdf * otherPdf;
+    return sum > 0.0f ? pdf2 / sum : 0.0f;
+}
+
 RayTracer::RayTracer(PixelBuffer *pixelBuffer, Scene *scene, Config &config)
-    : m_PixelBuffer(pixelBuffer), m_Scene(scene)
+    : m_PixelBuffer(pixelBuffer), m_SceneView(*scene)
 {
     auto size = m_PixelBuffer->getSize();
     m_FovX = atan2f((float)size.first, 2.0f);
     m_FovY = atan2f((float)size.second, 2.0f);
     m_aspectRatio = (float)size.first / (float)size.second;
     m_NumShadowRays = config.numShadowRays;
+    m_ShadowProbeRays = config.shadowProbeRays;
     m_MaxRecurseLevel = config.maxRecurseLevel;
+    m_Integrator = config.integrator;
+    m_RussianRouletteDepth = config.russianRouletteDepth;
+    m_Sampler = Sampler::create(config.sampler);
     vx = tanf(m_FovX / 2.0f);
     vy = tanf(m_FovY / 2.0f);
 }
@@ -22,14 +39,8 @@ void RayTracer::updateAspectRatio(float aspectRatio)
     m_aspectRatio = aspectRatio;
 }
 
-void RayTracer::sampleScene(float x, float y)
+auto RayTracer::sampleScene(float x, float y, const SampleStream &sample, RayCounts &rays) -> Vec3
 {
-    auto size = m_PixelBuffer->getSize();
-    auto width = (float)size.first;
-    auto height = (float)size.second;
-
-    Camera camera = m_Scene->getCamera();
-
     // find perpendicular vectors to the camera look direction vector
     // Vec3 vx = camera.dir.cross(Vec3(0.0f, 1.0f, 0.0f));
     // Vec3 vy = vx.cross(camera.dir);
@@ -47,74 +58,100 @@ void RayTracer::sampleScene(float x, float y)
     float worldX = ((x * 2.0f) - 1.0f) * vx * m_aspectRatio;
     float worldY = ((y * 2.0f) - 1.0f) * vy;
 
-    Vec3 pij = (camera.org + camera.dir) + Vec3(worldX, worldY, 0.0f);
+    Vec3 pij = m_SceneView.getViewPlaneCenter() + m_SceneView.getCameraRight() * worldX +
+               m_SceneView.getCameraUp() * worldY;
 
     // get the direction from camera origin to the sampled point
-    Vec3 dir = pij - camera.org;
+    Vec3 dir = pij - m_SceneView.getCameraOrg();
     dir.normalize();
 
     // create ray that will start at the camera origin and pass through the
     // sampled point on the view plane
-    Ray ray(camera.org, dir);
+    Ray ray(m_SceneView.getCameraOrg(), dir);
+
+    if (m_Integrator == Integrator::Path)
+    {
+        return tracePath(ray, sample, rays);
+    }
 
     Hit hit = shootRay(ray);
+    rays.pathRays++;
 
     if (hit.isHit)
     {
         unsigned int recurseLevel = 0;
-        Vec3 color = getHitColor(hit, recurseLevel);
+        return getHitColor(hit, recurseLevel, sample, rays);
+    }
 
-        int ix = static_cast<int>(floorf(static_cast<float>(size.first - 1) * x));
-        int iy = static_cast<int>(floorf(static_cast<float>(size.second - 1) * y));
+    return Vec3();
+}
 
-        m_PixelBufferGuard.lock();
-        m_PixelBuffer->setPixel(ix, iy, color);
-        m_PixelBufferGuard.unlock();
-    }
-    else
+auto RayTracer::renderTile(const Tile &tile, Vec3 *colors) -> RayCounts
+{
+    RayCounts rays;
+
+    auto size = m_PixelBuffer->getSize();
+    auto width = (float)size.first;
+    auto height = (float)size.second;
+
+    for (int y = tile.y0; y < tile.y1; y++)
     {
-        int ix = static_cast<int>(floorf(static_cast<float>(size.first - 1) * x));
-        int iy = static_cast<int>(floorf(static_cast<float>(size.second - 1) * y));
+        for (int x = tile.x0; x < tile.x1; x++)
+        {
+            SampleStream sample(*m_Sampler, static_cast<uint32_t>(x), static_cast<uint32_t>(y), tile.pass);
+
+            float jitterX, jitterY;
+            sample.next2D(jitterX, jitterY);
+            float sx = (static_cast<float>(x) + jitterX) / width;
+            float sy = (static_cast<float>(y) + jitterY) / height;
 
-        m_PixelBufferGuard.lock();
-        m_PixelBuffer->setPixel(ix, iy, Vec3());
-        m_PixelBufferGuard.unlock();
+            *colors++ = sampleScene(sx, sy, sample, rays);
+        }
     }
+
+    return rays;
 }
 
 auto RayTracer::shootRay(Ray ray) -> Hit
 {
-    Hit hit = m_Scene->getAccelerationStructure()->root->rayIntersect(ray);
+    Hit hit = m_SceneView.rayIntersect(ray);
     hit.ray = ray;
     return hit;
 }
 
-auto RayTracer::getHitColor(Hit hit, unsigned int recurseLevel) -> Vec3
+auto RayTracer::shootOcclusionRay(Ray ray, float maxDist) -> bool
+{
+    return m_SceneView.rayOccluded(ray, maxDist);
+}
+
+auto RayTracer::getHitColor(Hit hit, unsigned int recurseLevel, const SampleStream &sample, RayCounts &rays) -> Vec3
 {
     if (recurseLevel > m_MaxRecurseLevel)
     {
         return Vec3{};
     }
 
-    Material mat = *m_Scene->getMaterial(hit.materialName);
+    SampleStream bounceSample = sample.forBounce(recurseLevel);
+
+    const Material &mat = m_SceneView.getMaterial(hit.materialId);
 
     Vec3 finalColor = 0;
 
-    finalColor += m_Scene->getAmbientLighting() + mat.ambient;
+    finalColor += m_SceneView.getAmbientLighting() + mat.ambient;
 
-    for (std::shared_ptr<Light> light : m_Scene->getLightList())
+    for (const Light &light : m_SceneView.getLights())
     {
         // diffuse component
-        Vec3 lightDir = light->getPos() - hit.position;
+        Vec3 lightDir = light.getPos() - hit.position;
         float lightDist = lightDir.length();
         lightDir.normalize();
 
-        Vec3 lightDiffuse = light->getColor() * light->getIntensity() * (light->getIntensity() / lightDist);
+        Vec3 lightDiffuse = light.getColor() * light.getIntensity() * (light.getIntensity() / lightDist);
         Vec3 dotDiffuse = std::max(lightDir.dot(hit.normal), 0.0f);
         Vec3 diffuse = lightDiffuse * dotDiffuse * mat.diffuse;
 
         // specular component (Jim Blinn)
-        Vec3 view = m_Scene->getCamera().org - hit.position;
+        Vec3 view = m_SceneView.getCameraOrg() - hit.position;
         view.normalize();
 
         Vec3 halfWay = lightDir + view;
@@ -123,7 +160,7 @@ auto RayTracer::getHitColor(Hit hit, unsigned int recurseLevel) -> Vec3
         Vec3 specular = mat.specular * powf(hit.normal.dot(halfWay), mat.specularExponent);
 
         // shadow value
-        float shadowValue = shootShadowRays(light, hit.position);
+        float shadowValue = shootShadowRays(light, hit.position, bounceSample, rays);
 
         finalColor += (diffuse + specular) * shadowValue * (1.0f - mat.reflection);
 
@@ -131,10 +168,11 @@ auto RayTracer::getHitColor(Hit hit, unsigned int recurseLevel) -> Vec3
         {
             Ray reflectedRay = hit.ray.getReflectionRay(hit.position, hit.normal);
             Hit reflectionHit = shootRay(reflectedRay);
+            rays.pathRays++;
 
             if (reflectionHit.isHit)
             {
-                Vec3 reflectionColor = getHitColor(reflectionHit, ++recurseLevel);
+                Vec3 reflectionColor = getHitColor(reflectionHit, ++recurseLevel, sample, rays);
                 finalColor += reflectionColor * mat.reflection;
             }
         }
@@ -143,40 +181,160 @@ auto RayTracer::getHitColor(Hit hit, unsigned int recurseLevel) -> Vec3
     return finalColor;
 }
 
-auto RayTracer::shootShadowRays(std::shared_ptr<Light> light, Vec3 pos) -> float
+auto RayTracer::tracePath(Ray ray, const SampleStream &sample, RayCounts &rays) -> Vec3
 {
-    Vec3 lightCenterPos = light->getPos();
-    Vec3 lightCenterDir = lightCenterPos - pos;
+    Vec3 color = 0;
+    Vec3 throughput = 1;
 
-    Vec3 up = lightCenterDir.cross({0.0f, 1.0f, 0.0f});
+    // a light found by a mirror reflection or the camera ray could not have been found by light sampling, so it gets
+    // the full weight, after a diffuse or glossy bounce it is weighted against the light samples of that vertex
+    bool lastBounceMirror = true;
+    float lastBouncePdf = 0.0f;
 
-    Vec3 u = lightCenterDir.cross(up);
-    u.normalize();
+    Hit hit = shootRay(ray);
+    rays.pathRays++;
+    for (unsigned int bounce = 0;; bounce++)
+    {
+        const Light *hitLight = nullptr;
+        m_SceneView.rayHitLight(hit.ray, hit.time, hitLight);
+        if (hitLight)
+        {
+            float weight = 1.0f;
+            if (!lastBounceMirror)
+            {
+                float lightPdf = hitLight->pdf(hit.ray.org, hit.ray.dir);
+                weight = powerHeuristic(lastBouncePdf, static_cast<float>(m_NumShadowRays) * lightPdf);
+            }
+            color += throughput * hitLight->getRadiance() * weight;
+            break;
+        }
 
-    Vec3 v = lightCenterDir.cross(u);
-    v.normalize();
+        if (!hit.isHit || bounce > m_MaxRecurseLevel)
+        {
+            break;
+        }
 
-    unsigned int litSources = 0;
+        SampleStream bounceSample = sample.forBounce(bounce);
+        Bsdf bsdf(m_SceneView.getMaterial(hit.materialId), hit.normal, hit.ray.dir * -1.0f);
+
+        // rays leave the surface from slightly above it so they do not hit it again
+        Vec3 origin = hit.position + bsdf.getNormal() * rayOffset;
+
+        // the direction numbers come first so they are a stratified pair
+        float u1, u2, uLobe, uRoulette;
+        bounceSample.next2D(u1, u2);
+        bounceSample.next2D(uLobe, uRoulette);
+
+        color += throughput * sampleLights(bsdf, origin, bounceSample, rays);
+
+        BsdfSample bsdfSample;
+        if (!bsdf.sample(uLobe, u1, u2, bsdfSample))
+        {
+            break;
+        }
 
-    for (unsigned int i = 0; i < m_NumShadowRays; i++)
+        throughput *= bsdfSample.weight;
+        lastBounceMirror = bsdfSample.isMirror;
+        lastBouncePdf = bsdfSample.pdf;
+
+        // past the minimum depth the path survives with a probability that follows its throughput, survivors are
+        // weighted up by the same amount so the estimate stays unbiased
+        if (bounce + 1 >= m_RussianRouletteDepth)
+        {
+            float survival = std::min(std::max({throughput.x, throughput.y, throughput.z}), 1.0f);
+            if (uRoulette >= survival)
+            {
+                break;
+            }
+            throughput *= 1.0f / survival;
+        }
+
+        // the hit is reused for the next vertex of the path
+        hit = shootRay(Ray(origin, bsdfSample.dir));
+        rays.pathRays++;
+    }
+
+    return color;
+}
+
+auto RayTracer::sampleLights(const Bsdf &bsdf, Vec3 pos, SampleStream &sample, RayCounts &rays) -> Vec3
+{
+    Vec3 directLight = 0;
+
+    for (const Light &light : m_SceneView.getLights())
     {
-        float rx = ((static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 2.0f) - 1) * light->getRadius();
-        float ry = ((static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 2.0f) - 1) * light->getRadius();
+        for (unsigned int i = 0; i < m_NumShadowRays; i++)
+        {
+            LightSample lightSample;
+            float u1, u2;
+            sample.next2D(u1, u2);
+            if (!light.sample(pos, u1, u2, lightSample))
+            {
+                continue;
+            }
 
-        Vec3 lightPos = lightCenterPos + (u * rx) + (v * ry);
+            // surfaces facing away from the light are skipped before tracing a shadow ray
+            Vec3 reflected = bsdf.evaluate(lightSample.dir);
+            if (reflected.x <= 0.0f && reflected.y <= 0.0f && reflected.z <= 0.0f)
+            {
+                continue;
+            }
 
-        Vec3 lightDir = lightPos - pos;
-        float lightDist = lightDir.length();
-        lightDir.normalize();
+            rays.shadowRays++;
+            if (shootOcclusionRay(Ray(pos, lightSample.dir), lightSample.dist))
+            {
+                continue;
+            }
 
-        Ray shadowRay(pos, lightDir);
-        Hit shadowHit = shootRay(shadowRay);
+            // a point light can only be found by sampling it
+            float weight = 1.0f;
+            if (!light.isPoint())
+            {
+                float numSamples = static_cast<float>(m_NumShadowRays);
+                weight = powerHeuristic(numSamples * lightSample.pdf, bsdf.pdf(lightSample.dir));
+            }
+
+            directLight += reflected * lightSample.radiance * (weight / (m_NumShadowRays * lightSample.pdf));
+        }
+    }
+
+    return directLight;
+}
+
+auto RayTracer::shootShadowRays(const Light &light, Vec3 pos, SampleStream &sample, RayCounts &rays) -> float
+{
+    // every ray to a point light takes the same path
+    unsigned int numRays = light.isPoint() ? std::min(m_NumShadowRays, 1U) : m_NumShadowRays;
+
+    // a few probe rays decide if the position is in the penumbra, only then are the remaining rays needed
+    unsigned int numProbes = std::min(m_ShadowProbeRays, numRays);
+
+    unsigned int litSources = 0;
+
+    for (unsigned int i = 0; i < numRays; i++)
+    {
+        if (numProbes > 0 && i == numProbes && (litSources == 0 || litSources == numProbes))
+        {
+            return static_cast<float>(litSources) / static_cast<float>(numProbes);
+        }
+
+        float u1, u2;
+        sample.next2D(u1, u2);
+
+        // positions inside the light's sphere are lit
+        LightSample lightSample;
+        if (!light.sample(pos, u1, u2, lightSample))
+        {
+            litSources++;
+            continue;
+        }
 
-        if (lightDist < shadowHit.time)
+        rays.shadowRays++;
+        if (!shootOcclusionRay(Ray(pos, lightSample.dir), lightSample.dist))
         {
             litSources++;
         }
     }
 
-    return static_cast<float>(litSources) / static_cast<float>(m_NumShadowRays);
+    return numRays > 0 ? static_cast<float>(litSources) / static_cast<float>(numRays) : 1.0f;
 }
@@ -1,17 +1,42 @@
 #pragma once
-#include <mutex>
-
+#include "Bsdf.h"
 #include "Camera.h"
 #include "Hit.h"
 #include "Scene/Scene.h"
+#include "Scene/SceneView.h"
+#include "TileScheduler.h"
 #include "Utils/Config.h"
+#include "Utils/Sampler.h"
 #include "Window/PixelBuffer.h"
 
+/**
+ * \brief The number of rays traced for a set of samples.
+ */
+struct RayCounts
+{
+    /**
+     * \brief Camera rays and the reflection or bounce rays that continue a path.
+     */
+    unsigned long long pathRays = 0;
+
+    /**
+     * \brief Rays that test if a light is visible.
+     */
+    unsigned long long shadowRays = 0;
+
+    inline void operator+=(const RayCounts &counts)
+    {
+        pathRays += counts.pathRays;
+        shadowRays += counts.shadowRays;
+    }
+};
+
 /**
  * \brief Class that shoots rays into a scene and calculates light values.
  *
  * A class that writes color values to a pixel buffer. The color value is determined by shooting a ray into the scene
- * and calculating the resulting intersection based on the Blinn-Phong lighting model.
+ * and calculating the resulting intersection. The config picks between the Blinn-Phong lighting model with recursive
+ * reflections in getHitColor and the Monte Carlo path tracer in tracePath.
  */
 class RayTracer
 {
@@ -19,7 +44,9 @@ class RayTracer
     /**
      * \brief Creates a RayTracer object.
      *
-     * Creates a RayTracer object with a pixel buffer to write to and a scene to render.
+     * Creates a RayTracer object with a pixel buffer to write to and a scene to render. The ray tracer renders a
+     * SceneView snapshot of the scene, so the scene's acceleration structure must be built before and the scene must
+     * outlive the ray tracer.
      *
      * \param pixelBuffer The pixel buffer that the ray tracer will write to.
      * \param scene The scene that the ray tracer will shoot rays into.
@@ -35,15 +62,31 @@ class RayTracer
     ~RayTracer();
 
     /**
-     * \brief Calculates the color at one point in the window and writes to the pixel buffer.
+     * \brief Calculates the color at one point in the window.
      *
      * Calculates the color at the point (x, y) in the window. The point (0, 0) represents the top left corner of the
      * screen and the point (1, 1) represents the bottom right coner of the window.
      *
      * \param x The horizontal coordinate of the point to calculate between 0 and 1.
      * \param y The vertical coordinate of the point to calculate between 0 and 1.
+     * \param sample The numbers of the sample, the pixel position has already been drawn from them.
+     * \param rays Incremented by the number of rays traced for the sample.
+     * \returns The color of the sample, black if the ray hits nothing.
+     */
+    auto sampleScene(float x, float y, const SampleStream &sample, RayCounts &rays) -> Vec3;
+
+    /**
+     * \brief Takes one sample in every pixel of a tile.
+     *
+     * Every sample is jittered inside its pixel. The numbers of a sample are drawn from the sampler by its pixel and
+     * the pass of the tile, which is the sample's index in the pixel, so the image does not depend on which worker
+     * renders which tile.
+     *
+     * \param tile The tile of the pixel buffer to sample.
+     * \param colors Set to the sampled colors of the tile's pixels, row by row.
+     * \returns The number of rays traced for the tile.
      */
-    void sampleScene(float x, float y);
+    auto renderTile(const Tile &tile, Vec3 *colors) -> RayCounts;
 
     /**
      * \brief Shoots a ray into the scene.
@@ -55,6 +98,18 @@ class RayTracer
      */
     auto shootRay(Ray ray) -> Hit;
 
+    /**
+     * \brief Checks if anything blocks a ray before it travels a given distance.
+     *
+     * Unlike shootRay no hit is built and the search stops at the first blocking object, which makes it the cheaper
+     * query for shadow rays.
+     *
+     * \param ray The ray being shot into the scene.
+     * \param maxDist The distance along the ray after which objects no longer block it.
+     * \returns True if an object is hit within maxDist.
+     */
+    auto shootOcclusionRay(Ray ray, float maxDist) -> bool;
+
     /**
      * \brief Calculates the color of a ray scene intersection.
      *
@@ -64,36 +119,76 @@ class RayTracer
      *
      * \param hit The hit to calculate the color of.
      * \param recurseLevel The current level of recursion used for reflection calculations.
+     * \param sample The numbers of the sample, every recursion level draws from its own dimensions.
+     * \param rays Incremented by the number of reflection and shadow rays traced.
      * \returns The color of the hit as a Vector3.
      */
-    auto getHitColor(Hit hit, unsigned int recurseLevel) -> Vec3;
+    auto getHitColor(Hit hit, unsigned int recurseLevel, const SampleStream &sample, RayCounts &rays) -> Vec3;
+
+    /**
+     * \brief Calculates the color of a camera ray by following its path through the scene.
+     *
+     * Every vertex of the path gathers the light of the scene's lights by sampling points on them, then continues in
+     * a single direction sampled from the bsdf of its material, so light bouncing between surfaces is included. A
+     * light the continued path runs into is weighted against the light samples that could have found it with
+     * multiple importance sampling. The light of a vertex is weighted by the path throughput, the product of the
+     * bsdf sample weights of the vertices before it, so the work per sample grows linearly with the number of
+     * bounces.
+     *
+     * After russianRouletteDepth bounces a path is ended at random with a probability that grows as its throughput
+     * falls, and the paths that continue are weighted up to make up for the ended ones.
+     *
+     * \param ray The camera ray the path starts with.
+     * \param sample The numbers of the sample, every bounce draws from its own dimensions.
+     * \param rays Incremented by the number of rays traced for the path.
+     * \returns The light the path carries to the camera, black if the camera ray hits nothing.
+     */
+    auto tracePath(Ray ray, const SampleStream &sample, RayCounts &rays) -> Vec3;
 
     /**
      * \brief Calculates if the position is in a shadow.
      *
-     * Shoots multiple rays from a position in a cone towards a light source to see if that position is shadowed.
+     * Shoots rays from a position in directions spread evenly over the cone the light's sphere covers to see how much
+     * of the light is visible. If shadowProbeRays is set, that many rays are shot first and the rest of the
+     * numShadowRays are only shot if the probes disagree, so only positions in a penumbra pay for all rays.
      *
      * \param light The light source that potentially casts a shadow on the position.
      * \param pos The position where the rays are cast from to determine if it is in shadow.
+     * \param sample The numbers used to pick the points on the light.
+     * \param rays Incremented by the number of shadow rays traced.
      * \returns A float value that determines how much the position is in shadow. 0 is completely in shadow and 1 is
      * completly lit.
      */
-    auto shootShadowRays(std::shared_ptr<Light> light, Vec3 pos) -> float;
+    auto shootShadowRays(const Light &light, Vec3 pos, SampleStream &sample, RayCounts &rays) -> float;
 
     void updateAspectRatio(float aspectRatio);
 
   private:
+    /**
+     * the light of all lights reflected at a path vertex, numShadowRays points are sampled on every light and each is
+     * weighted against the bsdf sampling that could have found it
+     */
+    auto sampleLights(const Bsdf &bsdf, Vec3 pos, SampleStream &sample, RayCounts &rays) -> Vec3;
+
+    /**
+     * the distance along the normal that rays leaving a surface start above it
+     */
+    static constexpr float rayOffset = 1e-4f;
+
+    Integrator m_Integrator = Integrator::BlinnPhong;
     unsigned int m_NumShadowRays = 5;
+    unsigned int m_ShadowProbeRays = 0;
     unsigned int m_ReflectionLimit = 100;
     unsigned int m_MaxRecurseLevel = 10;
+    unsigned int m_RussianRouletteDepth = 3;
 
     float m_FovX{}, m_FovY{};
     float m_aspectRatio;
     Camera m_Camera;
 
-    Scene *m_Scene{};
+    SceneView m_SceneView;
+    std::unique_ptr<Sampler> m_Sampler;
     PixelBuffer *m_PixelBuffer{};
-    std::mutex m_PixelBufferGuard;
 
     float vx;
     float vy;
@@ -0,0 +1,211 @@
+#include "Renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+Renderer::Renderer(RayTracer *rayTracer, PixelBuffer *pixelBuffer, ThreadPool *threadPool, int tileSize,
+                   unsigned int maxPasses)
+    : m_RayTracer(rayTracer), m_PixelBuffer(pixelBuffer), m_ThreadPool(threadPool),
+      m_Scheduler(threadPool->getNumThreads(), tileSize, maxPasses),
+      m_NumSamplesPerWorker(threadPool->getNumThreads(), 0), m_RayCountsPerWorker(threadPool->getNumThreads()),
+      m_TileColorsPerWorker(threadPool->getNumThreads(), std::vector<Vec3>(std::max(tileSize * tileSize, 1)))
+{
+    restart();
+}
+
+Renderer::~Renderer()
+{
+    stop();
+}
+
+void Renderer::setAdaptiveSampling(float noiseThreshold, unsigned int minSamples)
+{
+    m_Scheduler.setAdaptive(noiseThreshold, minSamples,
+                            [this](unsigned int tileIndex) { return m_Accumulation.getTileError(tileIndex); });
+    restart();
+}
+
+void Renderer::start()
+{
+    if (m_Running)
+    {
+        return;
+    }
+
+    m_Running = true;
+    m_Stopping = false;
+    for (unsigned int i = 0; i < m_ThreadPool->getNumThreads(); i++)
+    {
+        m_ThreadPool->submit([this, i]() { renderLoop(i); });
+    }
+}
+
+void Renderer::pause()
+{
+    if (!m_Running)
+    {
+        return;
+    }
+
+    m_Paused = true;
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_WorkerParked.wait(lock, [this]() { return m_NumParked == m_ThreadPool->getNumThreads(); });
+}
+
+void Renderer::resume()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Paused = false;
+    }
+    m_Resumed.notify_all();
+}
+
+void Renderer::restart()
+{
+    auto size = m_PixelBuffer->getSize();
+    m_Scheduler.reset(size.first, size.second);
+    m_Accumulation.reset(m_Scheduler.getTiles());
+}
+
+void Renderer::resolve()
+{
+    m_NumResolvedTiles = 0;
+    m_NextResolveTile = 0;
+    m_ResolveRequested = true;
+
+    bool helpersSubmitted = !m_Running;
+    if (helpersSubmitted)
+    {
+        for (unsigned int i = 0; i < m_ThreadPool->getNumThreads(); i++)
+        {
+            m_ThreadPool->submit([this]() { resolveTiles(); });
+        }
+    }
+
+    resolveTiles();
+
+    // the last tiles may still be resolved by other threads
+    while (m_NumResolvedTiles < m_Accumulation.getNumTiles())
+    {
+        std::this_thread::yield();
+    }
+    m_ResolveRequested = false;
+
+    if (helpersSubmitted)
+    {
+        m_ThreadPool->wait();
+    }
+}
+
+void Renderer::stop()
+{
+    if (!m_Running)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Resumed.notify_all();
+    m_ThreadPool->wait();
+
+    m_Running = false;
+}
+
+auto Renderer::getNumSamples() const -> unsigned long long
+{
+    return std::accumulate(m_NumSamplesPerWorker.begin(), m_NumSamplesPerWorker.end(), 0ULL);
+}
+
+auto Renderer::getRayCounts() const -> RayCounts
+{
+    RayCounts rays;
+    for (const RayCounts &workerRays : m_RayCountsPerWorker)
+    {
+        rays += workerRays;
+    }
+    return rays;
+}
+
+auto Renderer::waitUntilFinished(float timeLimit) -> bool
+{
+    auto finished = [this]() { return m_Scheduler.isFinished() && m_NumParked == m_ThreadPool->getNumThreads(); };
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (timeLimit <= 0.0f)
+    {
+        m_WorkerParked.wait(lock, finished);
+        return true;
+    }
+
+    return m_WorkerParked.wait_for(lock, std::chrono::duration<float>(timeLimit), finished);
+}
+
+/**
+ * renders tiles until the renderer is stopped
+ *
+ * \param workerIndex - the index of the worker, picks its tile deque
+ */
+void Renderer::renderLoop(unsigned int workerIndex)
+{
+    while (!m_Stopping)
+    {
+        if (m_ResolveRequested)
+        {
+            resolveTiles();
+        }
+
+        if (m_Paused || m_Scheduler.isFinished())
+        {
+            park();
+            continue;
+        }
+
+        Tile tile;
+        if (!m_Scheduler.nextTile(workerIndex, tile))
+        {
+            // the last tiles of the pass are still being rendered by other workers
+            std::this_thread::yield();
+            continue;
+        }
+
+        // the tile is rendered into scratch colors and added with a single tile lock
+        Vec3 *colors = m_TileColorsPerWorker[workerIndex].data();
+        m_RayCountsPerWorker[workerIndex] += m_RayTracer->renderTile(tile, colors);
+        m_Accumulation.addTile(tile, colors);
+        m_Scheduler.finishTile(tile);
+
+        m_NumSamplesPerWorker[workerIndex] += static_cast<unsigned long long>(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    }
+}
+
+/**
+ * resolves tiles of the current resolve request until none are left
+ */
+void Renderer::resolveTiles()
+{
+    unsigned int numTiles = m_Accumulation.getNumTiles();
+    for (unsigned int i = m_NextResolveTile++; i < numTiles; i = m_NextResolveTile++)
+    {
+        m_Accumulation.resolveTile(i, *m_PixelBuffer);
+        m_NumResolvedTiles++;
+    }
+}
+
+/**
+ * idles the calling worker while the renderer is paused or has nothing left to render
+ */
+void Renderer::park()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_NumParked++;
+    m_WorkerParked.notify_all();
+
+    m_Resumed.wait(lock, [this]() { return (!m_Paused && !m_Scheduler.isFinished()) || m_Stopping; });
+    m_NumParked--;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "AccumulationBuffer.h"
+#include "RayTracer.h"
+#include "TileScheduler.h"
+#include "Utils/ThreadPool.h"
+#include "Window/PixelBuffer.h"
+
+/**
+ * \brief Keeps the worker threads of a thread pool tracing tiles of the pixel buffer.
+ *
+ * The workers take tiles from a TileScheduler and render them while the main thread presents the pixel buffer, there
+ * is no per frame thread creation or join. The samples are summed in an AccumulationBuffer that is only resolved into
+ * the pixel buffer when a frame is presented. The workers can be paused to safely change state they read, like the
+ * pixel buffer size, and go idle once the scheduler has rendered all of its passes.
+ */
+class Renderer
+{
+  public:
+    /**
+     * \brief Creates a Renderer.
+     *
+     * \param rayTracer The ray tracer the workers sample the scene with.
+     * \param pixelBuffer The pixel buffer the ray tracer writes to, its size decides the tiles.
+     * \param threadPool The thread pool whose workers are used for rendering.
+     * \param tileSize The width and height of a tile in pixels.
+     * \param maxPasses The number of samples per pixel after which the workers go idle.
+     */
+    Renderer(RayTracer *rayTracer, PixelBuffer *pixelBuffer, ThreadPool *threadPool, int tileSize = 16,
+             unsigned int maxPasses = UINT_MAX);
+
+    /**
+     * \brief Stops the workers if they are still rendering.
+     */
+    ~Renderer();
+
+    /**
+     * \brief Stops sampling tiles whose estimated error is below a noise threshold.
+     *
+     * Once every tile is below the threshold the workers go idle. Must be called before start.
+     *
+     * \param noiseThreshold The relative error at which a tile is converged, 0 disables adaptive sampling.
+     * \param minSamples The number of samples every pixel gets before its error is trusted.
+     */
+    void setAdaptiveSampling(float noiseThreshold, unsigned int minSamples);
+
+    /**
+     * \brief Starts one render loop on every worker of the thread pool.
+     */
+    void start();
+
+    /**
+     * \brief Blocks until every worker has stopped sampling.
+     *
+     * The workers stay parked until resume is called.
+     */
+    void pause();
+
+    /**
+     * \brief Lets paused workers continue sampling.
+     */
+    void resume();
+
+    /**
+     * \brief Writes the average of all samples taken so far into the pixel buffer.
+     *
+     * The tiles are resolved in parallel by the calling thread together with the workers, which pick up resolve work
+     * between tiles. When the renderer is stopped the idle thread pool workers are used instead.
+     */
+    void resolve();
+
+    /**
+     * \brief Retiles the pixel buffer and starts again from the first pass.
+     *
+     * Must only be called while the renderer is paused, typically after the pixel buffer was resized.
+     */
+    void restart();
+
+    /**
+     * \brief Ends the render loops and waits for the workers to return to the thread pool.
+     *
+     * Tiles that are being rendered are finished first.
+     */
+    void stop();
+
+    /**
+     * \brief Blocks until every pass has been rendered.
+     *
+     * \param timeLimit The maximum number of seconds to wait, 0 waits without a limit.
+     * \returns True if every pass was rendered, false if the time limit was reached first.
+     */
+    auto waitUntilFinished(float timeLimit = 0.0f) -> bool;
+
+    /**
+     * \brief The number of passes rendered, every pixel has received at most this many samples.
+     */
+    auto inline getCompletedPasses() const -> unsigned int
+    {
+        return m_Scheduler.getCompletedPasses();
+    }
+
+    /**
+     * \brief True once adaptive sampling has brought every tile below the noise threshold.
+     */
+    auto inline isConverged() const -> bool
+    {
+        return m_Scheduler.isConverged();
+    }
+
+    /**
+     * \brief The number of samples taken by all workers, only exact while the renderer is stopped.
+     */
+    auto getNumSamples() const -> unsigned long long;
+
+    /**
+     * \brief The number of rays traced by all workers, only exact while the renderer is stopped.
+     */
+    auto getRayCounts() const -> RayCounts;
+
+  private:
+    void renderLoop(unsigned int workerIndex);
+    void park();
+    void resolveTiles();
+
+    RayTracer *m_RayTracer;
+    PixelBuffer *m_PixelBuffer;
+    ThreadPool *m_ThreadPool;
+    TileScheduler m_Scheduler;
+    AccumulationBuffer m_Accumulation;
+
+    std::atomic<bool> m_Paused = false;
+    std::atomic<bool> m_Stopping = false;
+    bool m_Running = false;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkerParked;
+    std::condition_variable m_Resumed;
+    unsigned int m_NumParked = 0;
+
+    std::atomic<bool> m_ResolveRequested = false;
+    std::atomic<unsigned int> m_NextResolveTile = 0;
+    std::atomic<unsigned int> m_NumResolvedTiles = 0;
+
+    // written only by the worker with the same index
+    std::vector<unsigned long long> m_NumSamplesPerWorker{};
+    std::vector<RayCounts> m_RayCountsPerWorker{};
+    std::vector<std::vector<Vec3>> m_TileColorsPerWorker{};
+};
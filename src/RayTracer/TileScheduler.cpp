@@ -0,0 +1,173 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * interleaves the lower 16 bits of x and y into a 32 bit Morton code
+ */
+static auto mortonCode2D(uint32_t x, uint32_t y) -> uint32_t
+{
+    auto spreadBits = [](uint32_t v) {
+        v &= 0x0000ffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+
+    return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+TileScheduler::TileScheduler(unsigned int numWorkers, int tileSize, unsigned int maxPasses)
+    : m_TileSize(std::max(tileSize, 1)), m_MaxPasses(maxPasses)
+{
+    numWorkers = std::max(numWorkers, 1U);
+    for (unsigned int i = 0; i < numWorkers; i++)
+    {
+        m_Queues.push_back(std::make_unique<WorkerQueue>());
+    }
+}
+
+void TileScheduler::reset(int width, int height)
+{
+    m_Tiles.clear();
+
+    int numTilesX = (width + m_TileSize - 1) / m_TileSize;
+    int numTilesY = (height + m_TileSize - 1) / m_TileSize;
+
+    for (int ty = 0; ty < numTilesY; ty++)
+    {
+        for (int tx = 0; tx < numTilesX; tx++)
+        {
+            Tile tile;
+            tile.x0 = tx * m_TileSize;
+            tile.y0 = ty * m_TileSize;
+            tile.x1 = std::min(tile.x0 + m_TileSize, width);
+            tile.y1 = std::min(tile.y0 + m_TileSize, height);
+            m_Tiles.push_back(tile);
+        }
+    }
+
+    // neighbouring tiles along the Morton curve are close in the image
+    std::sort(m_Tiles.begin(), m_Tiles.end(), [this](const Tile &a, const Tile &b) {
+        return mortonCode2D(a.x0 / m_TileSize, a.y0 / m_TileSize) < mortonCode2D(b.x0 / m_TileSize, b.y0 / m_TileSize);
+    });
+
+    for (unsigned int i = 0; i < m_Tiles.size(); i++)
+    {
+        m_Tiles[i].index = i;
+    }
+
+    m_Pass = 0;
+    m_Converged = false;
+    m_Finished = m_Tiles.empty() || m_MaxPasses == 0;
+    if (!m_Finished)
+    {
+        startPass();
+    }
+}
+
+void TileScheduler::setAdaptive(float noiseThreshold, unsigned int minPasses,
+                                std::function<float(unsigned int)> tileError)
+{
+    m_NoiseThreshold = noiseThreshold;
+    m_MinAdaptivePasses = std::max(minPasses, 2U);
+    m_TileError = std::move(tileError);
+}
+
+auto TileScheduler::nextTile(unsigned int workerIndex, Tile &tile) -> bool
+{
+    auto numQueues = static_cast<unsigned int>(m_Queues.size());
+    workerIndex %= numQueues;
+
+    // take from the front of the own deque
+    {
+        WorkerQueue &queue = *m_Queues[workerIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tiles.empty())
+        {
+            tile = m_Tiles[queue.tiles.front()];
+            queue.tiles.pop_front();
+            tile.pass = m_Pass;
+            return true;
+        }
+    }
+
+    // steal from the back of the other deques, the tiles furthest from where their owner is working
+    for (unsigned int i = 1; i < numQueues; i++)
+    {
+        WorkerQueue &victim = *m_Queues[(workerIndex + i) % numQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tiles.empty())
+        {
+            tile = m_Tiles[victim.tiles.back()];
+            victim.tiles.pop_back();
+            tile.pass = m_Pass;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TileScheduler::finishTile(const Tile &tile)
+{
+    // the worker that finishes the last tile of the pass starts the next one
+    if (m_NumUnfinishedTiles.fetch_sub(1) == 1)
+    {
+        m_Pass++;
+        if (m_Pass >= m_MaxPasses)
+        {
+            m_Finished = true;
+        }
+        else
+        {
+            startPass();
+        }
+    }
+}
+
+/**
+ * picks the tiles of the next pass and deals them to the worker deques in contiguous runs of the Morton order
+ */
+void TileScheduler::startPass()
+{
+    m_PassTiles.clear();
+
+    bool adaptive = m_NoiseThreshold > 0.0f && m_TileError && m_Pass >= m_MinAdaptivePasses;
+    for (const Tile &tile : m_Tiles)
+    {
+        if (!adaptive || m_TileError(tile.index) > m_NoiseThreshold)
+        {
+            m_PassTiles.push_back(tile.index);
+        }
+    }
+
+    // every tile is below the noise threshold
+    if (m_PassTiles.empty())
+    {
+        m_Converged = true;
+        m_Finished = true;
+        return;
+    }
+
+    auto numQueues = static_cast<unsigned int>(m_Queues.size());
+    auto numTiles = static_cast<unsigned int>(m_PassTiles.size());
+    m_NumUnfinishedTiles = numTiles;
+
+    for (unsigned int q = 0; q < numQueues; q++)
+    {
+        unsigned int begin = (numTiles * q) / numQueues;
+        unsigned int end = (numTiles * (q + 1)) / numQueues;
+
+        WorkerQueue &queue = *m_Queues[q];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tiles.clear();
+        for (unsigned int i = begin; i < end; i++)
+        {
+            queue.tiles.push_back(m_PassTiles[i]);
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <climits>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * \brief A rectangular block of pixels that is rendered by one worker at a time.
+ */
+struct Tile
+{
+    /**
+     * \brief The index of the tile in the scheduler's tile list.
+     */
+    unsigned int index = 0;
+
+    /**
+     * \brief The first column and row of the tile.
+     */
+    int x0 = 0, y0 = 0;
+
+    /**
+     * \brief One past the last column and row of the tile.
+     */
+    int x1 = 0, y1 = 0;
+
+    /**
+     * \brief The pass the tile is rendered for, every pixel gets one sample per pass.
+     */
+    unsigned int pass = 0;
+};
+
+/**
+ * \brief Hands out the tiles of the framebuffer to the render workers.
+ *
+ * The framebuffer is split into square tiles ordered along a Morton curve. Every pass the tiles are dealt to the
+ * workers in contiguous runs of that order so each worker starts on a compact region of the image. A worker takes
+ * tiles from the front of its own deque and steals from the back of the other deques once its own is empty. The next
+ * pass only starts once every tile of the current pass is finished, so all pixels have the same number of samples at
+ * the end of a pass and no two workers ever render the same tile at once.
+ *
+ * With adaptive sampling enabled, a pass after the minimum number of passes only contains the tiles whose estimated
+ * error is still above the noise threshold. Once no tile is left the scheduler is finished and the image converged.
+ */
+class TileScheduler
+{
+  public:
+    /**
+     * \brief Creates a TileScheduler.
+     *
+     * \param numWorkers The number of workers that take tiles, each gets its own deque.
+     * \param tileSize The width and height of a tile in pixels.
+     * \param maxPasses The number of passes after which the scheduler is finished.
+     */
+    TileScheduler(unsigned int numWorkers, int tileSize = 16, unsigned int maxPasses = UINT_MAX);
+
+    /**
+     * \brief Splits a framebuffer into tiles and starts the first pass.
+     *
+     * Must not be called while workers are taking tiles.
+     *
+     * \param width The width of the framebuffer in pixels.
+     * \param height The height of the framebuffer in pixels.
+     */
+    void reset(int width, int height);
+
+    /**
+     * \brief Enables adaptive sampling.
+     *
+     * \param noiseThreshold The estimated error below which a tile gets no more samples, 0 disables adaptive sampling.
+     * \param minPasses The number of passes every tile is rendered for before its error is trusted.
+     * \param tileError Returns the estimated error of a tile, only called between passes.
+     */
+    void setAdaptive(float noiseThreshold, unsigned int minPasses, std::function<float(unsigned int)> tileError);
+
+    /**
+     * \brief Takes the next tile for a worker.
+     *
+     * \param workerIndex The index of the worker asking for a tile.
+     * \param tile Set to the tile the worker should render.
+     * \returns False if no tile is available right now, either because the last tiles of the pass are still being
+     * rendered or because the scheduler is finished.
+     */
+    auto nextTile(unsigned int workerIndex, Tile &tile) -> bool;
+
+    /**
+     * \brief Marks a tile taken with nextTile as rendered.
+     *
+     * Finishing the last tile of a pass starts the next pass.
+     */
+    void finishTile(const Tile &tile);
+
+    /**
+     * \brief True once maxPasses passes are complete.
+     */
+    auto inline isFinished() const -> bool
+    {
+        return m_Finished;
+    }
+
+    /**
+     * \brief True if the scheduler finished because every tile is below the noise threshold.
+     */
+    auto inline isConverged() const -> bool
+    {
+        return m_Converged;
+    }
+
+    /**
+     * \brief The number of passes that have been completed, converged tiles may have been skipped in later passes.
+     */
+    auto inline getCompletedPasses() const -> unsigned int
+    {
+        return m_Pass;
+    }
+
+    auto inline getTiles() const -> const std::vector<Tile> &
+    {
+        return m_Tiles;
+    }
+
+  private:
+    void startPass();
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<unsigned int> tiles;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_Queues{};
+    std::vector<Tile> m_Tiles{};
+
+    int m_TileSize;
+    unsigned int m_MaxPasses;
+
+    float m_NoiseThreshold = 0.0f;
+    unsigned int m_MinAdaptivePasses = 0;
+    std::function<float(unsigned int)> m_TileError{};
+    std::vector<unsigned int> m_PassTiles{};
+
+    std::atomic<unsigned int> m_Pass = 0;
+    std::atomic<unsigned int> m_NumUnfinishedTiles = 0;
+    std::atomic<bool> m_Finished = false;
+    std::atomic<bool> m_Converged = false;
+};
@@ -1,150 +1,1127 @@
 #include "BVH.h"
 
+#include <chrono>
 #include <cmath>
+#include <stdexcept>
+
+#include "Utils/CpuFeatures.h"
+#include "Utils/ThreadPool.h"
+#include "WideBVH.h"
+
+/**
+ * the x, y or z coordinate of a vector
+ */
+static auto component(const Vec3 &v, int axis) -> float
+{
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+/**
+ * spreads the lower 21 bits of v out so two zero bits follow each of them
+ */
+static auto spreadBits3D(uint64_t v) -> uint64_t
+{
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffff;
+    v = (v | (v << 16)) & 0x1f0000ff0000ff;
+    v = (v | (v << 8)) & 0x100f00f00f00f00f;
+    v = (v | (v << 4)) & 0x10c30c30c30c30c3;
+    v = (v | (v << 2)) & 0x1249249249249249;
+    return v;
+}
+
+/**
+ * clears every bit of v but the highest set one
+ */
+static auto highestBit(uint64_t v) -> uint64_t
+{
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    v |= v >> 32;
+    return v ^ (v >> 1);
+}
+
+auto parseBVHBuilder(const std::string &name) -> BVHBuilder
+{
+    if (name == "sah")
+    {
+        return BVHBuilder::SAH;
+    }
+    if (name == "morton")
+    {
+        return BVHBuilder::Morton;
+    }
+    throw std::invalid_argument("Unknown BVH builder '" + name + "', use sah or morton!");
+}
+
+/**
+ * maps center points to the bins of the axes of a range's center bounds
+ */
+struct BinMapping
+{
+    float min[3];
+    float scale[3];
+    unsigned int numBins;
+
+    BinMapping(const BoundingBox &centerBounds, unsigned int numBins) : numBins(numBins)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = centerBounds.getMin(axis);
+            float extent = centerBounds.getMax(axis) - min[axis];
+            scale[axis] = extent > 0.0f ? static_cast<float>(numBins) / extent : 0.0f;
+        }
+    }
+
+    auto inline index(const Vec3 &center, int axis) const -> unsigned int
+    {
+        auto bin = static_cast<unsigned int>((component(center, axis) - min[axis]) * scale[axis]);
+        return std::min(bin, numBins - 1);
+    }
+};
+
+/**
+ * creates a binary bounding volume heirarchy
+ *
+ * the top of a SAH tree is split by all threads of the pool together, the subtrees below are built by one task each
+ *
+ * \param objectList - the list of objects whose primitives make up the BVH
+ * \param settings - the builder, leaf size and surface area heuristic costs of the build
+ * \param threadPool - the pool that builds the BVH, it is built on the calling thread if this is null
+ */
+BVH::BVH(std::vector<std::shared_ptr<SceneObject>> objectList, const BVHBuildSettings &settings,
+         ThreadPool *threadPool)
+    : m_OjectList(std::move(objectList)), m_Settings(settings), m_ThreadPool(threadPool)
+{
+    m_Settings.maxObjectsInLeaf = std::max(m_Settings.maxObjectsInLeaf, 1U);
+    m_Settings.numBins = std::clamp(m_Settings.numBins, 2U, maxBins);
+
+    build();
+}
+
+BVH::BVH(std::vector<std::shared_ptr<SceneObject>> objectList, BVHData data, const BVHBuildSettings &settings)
+    : m_OjectList(std::move(objectList)), m_Primitives(std::move(data.primitives)), m_Nodes(std::move(data.nodes)),
+      m_Settings(settings), m_ThreadPool(nullptr)
+{
+    m_Settings.maxObjectsInLeaf = std::max(m_Settings.maxObjectsInLeaf, 1U);
+    m_Settings.numBins = std::clamp(m_Settings.numBins, 2U, maxBins);
+
+    measureTree();
+    m_BuildSAHCost = m_SAHCost;
+    printTree();
+    createWideBVH(std::move(data.wideNodes4), std::move(data.wideNodes8));
+}
+
+BVH::~BVH() = default;
+
+/**
+ * builds the tree over the current bounds of the primitives of the objects
+ */
+void BVH::build()
+{
+    auto buildStart = std::chrono::steady_clock::now();
+
+    // the parents are found again by the Morton build or the first refit of the new tree
+    m_Parents.clear();
+
+    std::vector<PrimitiveRef> primitives;
+    for (uint32_t object = 0; object < m_OjectList.size(); object++)
+    {
+        unsigned int numObjectPrimitives = m_OjectList[object]->getNumPrimitives();
+        for (uint32_t primitive = 0; primitive < numObjectPrimitives; primitive++)
+        {
+            primitives.push_back({object, primitive});
+        }
+    }
+
+    std::cout << "Creating Acceleration Structure from " << primitives.size() << " primitives of "
+              << m_OjectList.size() << " objects." << std::endl;
+
+    auto numObjects = static_cast<unsigned int>(primitives.size());
+    m_BuildObjects.resize(numObjects);
+
+    // the bounds and centers of the primitives are cached, each chunk also bounds its own primitives
+    unsigned int numChunks = m_ThreadPool ? m_ThreadPool->getNumThreads() : 1;
+    std::vector<BoundingBox> chunkBounds(numChunks, BoundingBox::empty());
+    parallelFor(0, numObjects, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            SceneObject &object = *m_OjectList[primitives[i].object];
+            BuildObject &buildObject = m_BuildObjects[i];
+            buildObject.bounds = BoundingBox::of(object, primitives[i].primitive);
+            buildObject.center = object.getPrimitiveCenter(primitives[i].primitive);
+            buildObject.primitiveIndex = i;
+
+            chunkBounds[chunk].grow(buildObject.bounds);
+        }
+    });
+
+    if (numObjects > 0)
+    {
+        BuildRange root{0, 0, numObjects, 1, BoundingBox::empty()};
+        for (const BoundingBox &bounds : chunkBounds)
+        {
+            root.bounds.grow(bounds);
+        }
+
+        // a binary tree with a leaf per object has the most nodes
+        m_BuildNodes.clear();
+        m_BuildNodes.resize(2 * static_cast<size_t>(numObjects) - 1);
+        m_NextNode = 1;
+
+        if (m_Settings.builder == BVHBuilder::Morton)
+        {
+            buildMorton(root);
+        }
+        else if (m_ThreadPool)
+        {
+            std::vector<BuildRange> subtrees;
+            buildTopLevels(root, subtrees);
+
+            for (const BuildRange &subtree : subtrees)
+            {
+                m_ThreadPool->submit([this, subtree]() { buildSubtree(subtree); });
+            }
+            m_ThreadPool->wait();
+        }
+        else
+        {
+            buildSubtree(root);
+        }
+
+        m_BuildNodes.resize(m_NextNode);
+    }
+    m_Nodes = std::move(m_BuildNodes);
+
+    // the leaves reference the primitives in the order the build left them in
+    std::vector<PrimitiveRef> leafPrimitives(numObjects);
+    parallelFor(0, numObjects, [&](unsigned int, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            leafPrimitives[i] = primitives[m_BuildObjects[i].primitiveIndex];
+        }
+    });
+    m_Primitives = std::move(leafPrimitives);
+    m_BuildObjects.clear();
+    m_BuildObjects.shrink_to_fit();
+    m_PartitionScratch.clear();
+    m_PartitionScratch.shrink_to_fit();
+
+    m_BuildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+    measureTree();
+    m_BuildSAHCost = m_SAHCost;
+    printTree();
+
+    double millionObjects = std::max(static_cast<double>(numObjects), 1.0) / 1.0e6;
+    std::cout << (m_Settings.builder == BVHBuilder::Morton ? "Morton" : "SAH") << " BVH built in " << m_BuildTime
+              << " ms on " << numChunks << " threads (" << m_BuildTime / millionObjects
+              << " ms per million primitives)." << std::endl;
+
+    createWideBVH();
+}
+
+/**
+ * counts the nodes and leaves and computes the surface area heuristic cost of the tree
+ */
+void BVH::measureTree()
+{
+    // every node is weighted by the probability that a ray hitting the root box also hits the node
+    m_NumNodes = static_cast<unsigned int>(m_Nodes.size());
+    m_NumLeaves = 0;
+    m_SAHCost = 0.0f;
+    float rootArea = m_Nodes.empty() ? 0.0f : nodeBounds(m_Nodes[0]).surfaceArea();
+    for (const LinearBVHNode &node : m_Nodes)
+    {
+        m_NumLeaves += node.isLeaf() ? 1 : 0;
+        if (rootArea > 0.0f)
+        {
+            float cost = node.isLeaf() ? m_Settings.intersectionCost * static_cast<float>(node.numObjects)
+                                       : m_Settings.traversalCost;
+            m_SAHCost += cost * nodeBounds(node).surfaceArea() / rootArea;
+        }
+    }
+}
+
+void BVH::printTree() const
+{
+    std::cout << "BVH has " << m_NumNodes << " nodes, " << m_NumLeaves << " leaves and a SAH cost of " << m_SAHCost
+              << "." << std::endl;
+}
 
 /**
- * creates an actree bounding volume heirarchy
+ * collapses the binary tree into the wide tree rays are traced with
  *
- * \param objectList - the list of objects that make up the BVH
+ * \param wideNodes4 - the 4 wide nodes collapsed before, used instead of collapsing the tree if the width is 4
+ * \param wideNodes8 - the 8 wide nodes collapsed before, used instead of collapsing the tree if the width is 8
  */
-BVH::BVH(std::vector<std::shared_ptr<SceneObject>> objectList, unsigned int objectsInLeaf)
-    : m_OjectList(objectList), m_ObjectsInLeaf(objectsInLeaf)
+void BVH::createWideBVH(DataBuffer<WideBVHNode<4>> wideNodes4, DataBuffer<WideBVHNode<8>> wideNodes8)
+{
+    // the widest node whose child boxes the CPU can test with one instruction per plane
+    SimdLevel simdLevel = CpuFeatures::getSimdLevel();
+    unsigned int width = m_Settings.width;
+    if (width == 0)
+    {
+        width = simdLevel == SimdLevel::AVX ? 8 : 4;
+    }
+
+    if (m_Nodes.empty() || width < 4)
+    {
+        std::cout << "Tracing the binary BVH." << std::endl;
+        return;
+    }
+
+    unsigned int numWideNodes = 0;
+    if (width >= 8)
+    {
+        m_WideBVH8 =
+            std::make_unique<WideBVH<8>>(m_Nodes, m_OjectList, m_Primitives, simdLevel, std::move(wideNodes8));
+        numWideNodes = m_WideBVH8->getNumNodes();
+        simdLevel = m_WideBVH8->getSimdLevel();
+        m_Width = 8;
+    }
+    else
+    {
+        m_WideBVH4 =
+            std::make_unique<WideBVH<4>>(m_Nodes, m_OjectList, m_Primitives, simdLevel, std::move(wideNodes4));
+        numWideNodes = m_WideBVH4->getNumNodes();
+        simdLevel = m_WideBVH4->getSimdLevel();
+        m_Width = 4;
+    }
+
+    std::cout << "Tracing a " << m_Width << " wide BVH of " << numWideNodes << " nodes tested with "
+              << CpuFeatures::toString(simdLevel) << "." << std::endl;
+}
+
+void BVH::refit(ThreadPool *threadPool)
 {
-    std::cout << "Creating Acceleration Structure from " << objectList.size() << " objects." << std::endl;
-    root = std::make_shared<BVHNode>();
-    partitionSpace(root, m_OjectList);
+    if (m_Nodes.empty())
+    {
+        return;
+    }
+
+    m_ThreadPool = threadPool;
+    fitNodes(m_Nodes.mutableData(), static_cast<unsigned int>(m_Nodes.size()), [this](const LinearBVHNode &leaf) {
+        BoundingBox bounds = BoundingBox::empty();
+        for (uint32_t p = leaf.offset; p < leaf.offset + leaf.numObjects; p++)
+        {
+            const PrimitiveRef &primitive = m_Primitives[p];
+            bounds.grow(BoundingBox::of(*m_OjectList[primitive.object], primitive.primitive));
+        }
+        return bounds;
+    });
+
+    // the wide nodes copy the bounds of the binary nodes they were collapsed from
+    if (m_WideBVH8 && !m_WideBVH8->canRefit())
+    {
+        m_WideBVH8.reset();
+        createWideBVH();
+    }
+    else if (m_WideBVH4 && !m_WideBVH4->canRefit())
+    {
+        m_WideBVH4.reset();
+        createWideBVH();
+    }
+    else if (m_WideBVH8)
+    {
+        parallelFor(0, m_WideBVH8->getNumNodes(), [&](unsigned int, unsigned int begin, unsigned int end) {
+            m_WideBVH8->refit(m_Nodes, begin, end);
+        });
+    }
+    else if (m_WideBVH4)
+    {
+        parallelFor(0, m_WideBVH4->getNumNodes(), [&](unsigned int, unsigned int begin, unsigned int end) {
+            m_WideBVH4->refit(m_Nodes, begin, end);
+        });
+    }
+
+    measureTree();
+}
+
+void BVH::rebuild(ThreadPool *threadPool)
+{
+    m_ThreadPool = threadPool;
+    m_WideBVH4.reset();
+    m_WideBVH8.reset();
+    build();
+}
+
+auto BVH::update(ThreadPool *threadPool) -> bool
+{
+    refit(threadPool);
+    if (m_SAHCost <= m_BuildSAHCost * m_Settings.rebuildCostRatio)
+    {
+        return false;
+    }
+
+    std::cout << "BVH cost grew from " << m_BuildSAHCost << " to " << m_SAHCost << " while refitting, rebuilding it."
+              << std::endl;
+    rebuild(threadPool);
+    return true;
+}
+
+/**
+ * splits the ranges too large for one task, each one is binned and partitioned by all threads together
+ *
+ * \param root - the range of all build objects
+ * \param subtrees - gets the ranges that are left to be built by tasks
+ */
+void BVH::buildTopLevels(const BuildRange &root, std::vector<BuildRange> &subtrees)
+{
+    std::vector<BuildRange> ranges = {root};
+    while (!ranges.empty())
+    {
+        BuildRange range = ranges.back();
+        ranges.pop_back();
+
+        if (range.end - range.begin < parallelRangeSize)
+        {
+            subtrees.push_back(range);
+            continue;
+        }
+
+        BuildRange children[2];
+        if (splitRange(range, children, true))
+        {
+            ranges.push_back(children[0]);
+            ranges.push_back(children[1]);
+        }
+    }
+}
+
+/**
+ * builds the subtree of a range on the calling thread
+ * large children are handed to tasks of their own so idle threads can help
+ */
+void BVH::buildSubtree(BuildRange range)
+{
+    bool morton = m_Settings.builder == BVHBuilder::Morton;
+    BuildRange children[2];
+    while (morton ? splitMortonRange(range, children) : splitRange(range, children, false))
+    {
+        if (m_ThreadPool && children[1].end - children[1].begin >= taskRangeSize)
+        {
+            BuildRange child = children[1];
+            m_ThreadPool->submit([this, child]() { buildSubtree(child); });
+        }
+        else
+        {
+            buildSubtree(children[1]);
+        }
+
+        range = children[0];
+    }
+}
+
+/**
+ * turns the node of a range into a leaf or splits the range in two where the surface area heuristic is lowest
+ * splitting stops when it would cost more than intersecting every object of the range
+ *
+ * \param range - the range to split, its node is written
+ * \param children - set to the ranges of the two children if the range was split
+ * \param parallel - if the range is binned and partitioned by all threads of the pool
+ * \return - false if the node was made a leaf
+ */
+auto BVH::splitRange(const BuildRange &range, BuildRange children[2], bool parallel) -> bool
+{
+    LinearBVHNode &node = m_BuildNodes[range.nodeIndex];
+    setNodeBounds(node, range.bounds);
+    node.offset = range.begin;
+
+    unsigned int numObjects = range.end - range.begin;
+    node.numObjects = numObjects;
+    if (numObjects == 1 || range.depth >= maxDepth)
+    {
+        return false;
+    }
+
+    // bound the centers and bin them along every axis
+    BoundingBox centerBounds = BoundingBox::empty();
+    Bins bins;
+    if (parallel)
+    {
+        unsigned int numChunks = m_ThreadPool->getNumThreads();
+        std::vector<BoundingBox> chunkCenterBounds(numChunks, BoundingBox::empty());
+        parallelFor(range.begin, range.end, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                chunkCenterBounds[chunk].grow(m_BuildObjects[i].center);
+            }
+        });
+        for (const BoundingBox &bounds : chunkCenterBounds)
+        {
+            centerBounds.grow(bounds);
+        }
+
+        std::vector<Bins> chunkBins(numChunks);
+        parallelFor(range.begin, range.end, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+            binRange(begin, end, centerBounds, chunkBins[chunk]);
+        });
+
+        clearBins(bins);
+        for (const Bins &chunk : chunkBins)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                for (unsigned int b = 0; b < m_Settings.numBins; b++)
+                {
+                    bins[axis][b].bounds.grow(chunk[axis][b].bounds);
+                    bins[axis][b].numObjects += chunk[axis][b].numObjects;
+                }
+            }
+        }
+    }
+    else
+    {
+        for (unsigned int i = range.begin; i < range.end; i++)
+        {
+            centerBounds.grow(m_BuildObjects[i].center);
+        }
+        binRange(range.begin, range.end, centerBounds, bins);
+    }
+
+    // sweep the bin boundaries of every axis for the cheapest split
+    const unsigned int numBins = m_Settings.numBins;
+    float area = range.bounds.surfaceArea();
+    float invArea = area > 0.0f ? 1.0f / area : 0.0f;
+    float bestCost = INFINITY;
+    int bestAxis = 0;
+    unsigned int bestBin = 0;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (centerBounds.getMax(axis) <= centerBounds.getMin(axis))
+        {
+            continue;
+        }
+
+        // rightCosts[b] is the area weighted count of bins b and up
+        float rightCosts[maxBins];
+        BoundingBox rightBounds = BoundingBox::empty();
+        unsigned int rightCount = 0;
+        for (unsigned int b = numBins - 1; b > 0; b--)
+        {
+            rightBounds.grow(bins[axis][b].bounds);
+            rightCount += bins[axis][b].numObjects;
+            rightCosts[b] = rightBounds.surfaceArea() * static_cast<float>(rightCount);
+        }
+
+        BoundingBox leftBounds = BoundingBox::empty();
+        unsigned int leftCount = 0;
+        for (unsigned int b = 1; b < numBins; b++)
+        {
+            leftBounds.grow(bins[axis][b - 1].bounds);
+            leftCount += bins[axis][b - 1].numObjects;
+            if (leftCount == 0 || leftCount == numObjects)
+            {
+                continue;
+            }
+
+            float leftCost = leftBounds.surfaceArea() * static_cast<float>(leftCount);
+            float cost = m_Settings.traversalCost + m_Settings.intersectionCost * (leftCost + rightCosts[b]) * invArea;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b;
+            }
+        }
+    }
+
+    float leafCost = m_Settings.intersectionCost * static_cast<float>(numObjects);
+    if (numObjects <= m_Settings.maxObjectsInLeaf && leafCost <= bestCost)
+    {
+        return false;
+    }
+
+    unsigned int mid = 0;
+    if (std::isfinite(bestCost))
+    {
+        mid = partitionRange(range, centerBounds, bestAxis, bestBin, parallel);
+
+        // the bins on either side of the split bound the children
+        children[0].bounds = BoundingBox::empty();
+        children[1].bounds = BoundingBox::empty();
+        for (unsigned int b = 0; b < numBins; b++)
+        {
+            children[b < bestBin ? 0 : 1].bounds.grow(bins[bestAxis][b].bounds);
+        }
+    }
+    else
+    {
+        // all centers are in one spot and the leaf is too big, the range is split in half
+        mid = range.begin + numObjects / 2;
+        for (int c = 0; c < 2; c++)
+        {
+            children[c].bounds = BoundingBox::empty();
+            for (unsigned int i = c == 0 ? range.begin : mid; i < (c == 0 ? mid : range.end); i++)
+            {
+                children[c].bounds.grow(m_BuildObjects[i].bounds);
+            }
+        }
+    }
+
+    uint32_t firstChild = m_NextNode.fetch_add(2);
+    node.offset = firstChild;
+    node.numObjects = 0;
+
+    children[0].nodeIndex = firstChild;
+    children[0].begin = range.begin;
+    children[0].end = mid;
+    children[1].nodeIndex = firstChild + 1;
+    children[1].begin = mid;
+    children[1].end = range.end;
+    children[0].depth = children[1].depth = range.depth + 1;
+
+    return true;
 }
 
 /**
- * splits a list of scene objects into 8 axis aligned bounding boxes
- * the bounding boxes are split along axises that are the medians x, y, & z
- * values of the center points of the scene objects
+ * builds the tree over the build objects sorted along a Morton curve, a linear BVH
  *
- * \param objectList - the vector of scene objects the split
- * \param partitionedSpaces - the list of
+ * the sorted list is split top down at the highest bit in which the codes of a range differ, which only takes a
+ * binary search per node, then the bounds are fit bottom up from the leaves
+ *
+ * \param root - the range of all build objects
  */
-void BVH::partitionSpace(std::shared_ptr<BVHNode> node, std::vector<std::shared_ptr<SceneObject>> objectList)
+void BVH::buildMorton(const BuildRange &root)
 {
-    if (objectList.size() <= m_ObjectsInLeaf)
+    auto numObjects = static_cast<unsigned int>(m_BuildObjects.size());
+    unsigned int numChunks = m_ThreadPool ? m_ThreadPool->getNumThreads() : 1;
+    std::vector<BoundingBox> chunkCenterBounds(numChunks, BoundingBox::empty());
+    parallelFor(0, numObjects, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            chunkCenterBounds[chunk].grow(m_BuildObjects[i].center);
+        }
+    });
+    BoundingBox centerBounds = BoundingBox::empty();
+    for (const BoundingBox &bounds : chunkCenterBounds)
     {
-        // stop recursion
-        node->isLeaf = true;
-        node->sceneObjects = objectList;
+        centerBounds.grow(bounds);
+    }
+
+    // each axis of the center bounds is split into 2^bitsPerAxis cells
+    unsigned int bitsPerAxis = numObjects >= longMortonCodeSize ? 21 : 10;
+    auto numCells = static_cast<float>(1U << bitsPerAxis);
+    float min[3], scale[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        min[axis] = centerBounds.getMin(axis);
+        float extent = centerBounds.getMax(axis) - min[axis];
+        scale[axis] = extent > 0.0f ? numCells / extent : 0.0f;
+    }
+
+    m_MortonPrimitives.resize(numObjects);
+    parallelFor(0, numObjects, [&](unsigned int, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            uint64_t code = 0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float cell = (component(m_BuildObjects[i].center, axis) - min[axis]) * scale[axis];
+                cell = std::min(std::max(cell, 0.0f), numCells - 1.0f);
+                code |= spreadBits3D(static_cast<uint64_t>(cell)) << (2 - axis);
+            }
+            m_MortonPrimitives[i] = {code, i};
+        }
+    });
+
+    sortMortonPrimitives(3 * bitsPerAxis);
+
+    // the build objects are put in curve order so every node covers a range of them
+    m_PartitionScratch.resize(numObjects);
+    parallelFor(0, numObjects, [&](unsigned int, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            m_PartitionScratch[i] = m_BuildObjects[m_MortonPrimitives[i].index];
+        }
+    });
+    m_BuildObjects.swap(m_PartitionScratch);
+
+    if (m_ThreadPool)
+    {
+        m_ThreadPool->submit([this, root]() { buildSubtree(root); });
+        m_ThreadPool->wait();
     }
     else
     {
-        node->boundingBox = encapsulateObjects(objectList);
+        buildSubtree(root);
+    }
+    m_MortonPrimitives.clear();
+    m_MortonPrimitives.shrink_to_fit();
+
+    fitNodes(m_BuildNodes.data(), m_NextNode, [this](const LinearBVHNode &leaf) {
+        BoundingBox bounds = BoundingBox::empty();
+        for (uint32_t i = leaf.offset; i < leaf.offset + leaf.numObjects; i++)
+        {
+            bounds.grow(m_BuildObjects[i].bounds);
+        }
+        return bounds;
+    });
+}
 
-        std::vector<Vec3> centerPoints;
-        std::transform(objectList.begin(), objectList.end(), std::back_inserter(centerPoints),
-                       [](std::shared_ptr<SceneObject> sceneObject) { return sceneObject->getCenterPoint(); });
+/**
+ * sorts the Morton primitives by their codes with a least significant digit radix sort
+ *
+ * every pass each chunk counts the digits of its part of the list, then the chunks scatter their parts to the
+ * offsets that the counts of all chunks add up to, a pass whose digit is the same for every code is skipped
+ *
+ * \param numCodeBits - the number of low bits of the codes that can be set
+ */
+void BVH::sortMortonPrimitives(unsigned int numCodeBits)
+{
+    constexpr unsigned int digitBits = 11;
+    constexpr unsigned int numDigits = 1U << digitBits;
+
+    auto numObjects = static_cast<unsigned int>(m_MortonPrimitives.size());
+    unsigned int numChunks = m_ThreadPool ? m_ThreadPool->getNumThreads() : 1;
+    std::vector<MortonPrimitive> sorted(numObjects);
+    std::vector<unsigned int> offsets(static_cast<size_t>(numChunks) * numDigits);
+
+    for (unsigned int shift = 0; shift < numCodeBits; shift += digitBits)
+    {
+        parallelFor(0, numObjects, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+            unsigned int *counts = &offsets[static_cast<size_t>(chunk) * numDigits];
+            std::fill(counts, counts + numDigits, 0U);
+            for (unsigned int i = begin; i < end; i++)
+            {
+                counts[(m_MortonPrimitives[i].code >> shift) & (numDigits - 1)]++;
+            }
+        });
+
+        // a digit's codes go after the smaller digits and, within the digit, after the ones of earlier chunks
+        unsigned int offset = 0;
+        bool oneDigit = false;
+        for (unsigned int digit = 0; digit < numDigits; digit++)
+        {
+            unsigned int digitStart = offset;
+            for (unsigned int chunk = 0; chunk < numChunks; chunk++)
+            {
+                unsigned int &count = offsets[static_cast<size_t>(chunk) * numDigits + digit];
+                unsigned int chunkCount = count;
+                count = offset;
+                offset += chunkCount;
+            }
+            oneDigit = oneDigit || offset - digitStart == numObjects;
+        }
+        if (oneDigit)
+        {
+            continue;
+        }
+
+        parallelFor(0, numObjects, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+            unsigned int *chunkOffsets = &offsets[static_cast<size_t>(chunk) * numDigits];
+            for (unsigned int i = begin; i < end; i++)
+            {
+                unsigned int digit = (m_MortonPrimitives[i].code >> shift) & (numDigits - 1);
+                sorted[chunkOffsets[digit]++] = m_MortonPrimitives[i];
+            }
+        });
+        m_MortonPrimitives.swap(sorted);
+    }
+}
 
-        // get medians in x direction
-        std::sort(centerPoints.begin(), centerPoints.end(), [](Vec3 v, Vec3 u) { return v.x < u.x; });
-        float xMedian = centerPoints[centerPoints.size() / 2].x;
+/**
+ * turns the node of a range into a leaf or splits the sorted range where the highest bit in which its codes differ
+ * changes from 0 to 1, ranges whose codes are all the same are split in half
+ *
+ * \param range - the range to split, its node is written without bounds
+ * \param children - set to the ranges of the two children if the range was split
+ * \return - false if the node was made a leaf
+ */
+auto BVH::splitMortonRange(const BuildRange &range, BuildRange children[2]) -> bool
+{
+    LinearBVHNode &node = m_BuildNodes[range.nodeIndex];
+    node.offset = range.begin;
 
-        // get medians in y direction
-        std::sort(centerPoints.begin(), centerPoints.end(), [](Vec3 v, Vec3 u) { return v.y < u.y; });
-        float yMedian = centerPoints[centerPoints.size() / 2].y;
+    unsigned int numObjects = range.end - range.begin;
+    node.numObjects = numObjects;
+    if (numObjects <= std::min(m_Settings.maxObjectsInLeaf, maxMortonLeafSize) || range.depth >= maxDepth)
+    {
+        return false;
+    }
 
-        // get medians in z direction
-        std::sort(centerPoints.begin(), centerPoints.end(), [](Vec3 v, Vec3 u) { return v.z < u.z; });
-        float zMedian = centerPoints[centerPoints.size() / 2].z;
+    unsigned int mid = range.begin + numObjects / 2;
+    uint64_t splitBit = highestBit(m_MortonPrimitives[range.begin].code ^ m_MortonPrimitives[range.end - 1].code);
+    if (splitBit != 0)
+    {
+        // the codes share every bit above the split bit, so the ones with it cleared come first
+        auto first = m_MortonPrimitives.begin();
+        auto split = std::partition_point(first + range.begin, first + range.end, [splitBit](const MortonPrimitive &p) {
+            return (p.code & splitBit) == 0;
+        });
+        mid = static_cast<unsigned int>(split - first);
+    }
 
-        node->children = std::vector<std::shared_ptr<BVHNode>>(8);
+    uint32_t firstChild = m_NextNode.fetch_add(2);
+    node.offset = firstChild;
+    node.numObjects = 0;
 
-        node->children[0] = std::make_shared<BVHNode>();
-        node->children[0]->boundingBox = BoundingBox(node->boundingBox.minX, xMedian, node->boundingBox.minY, yMedian,
-                                                     node->boundingBox.minZ, zMedian);
+    children[0] = {firstChild, range.begin, mid, range.depth + 1, BoundingBox::empty()};
+    children[1] = {firstChild + 1, mid, range.end, range.depth + 1, BoundingBox::empty()};
 
-        node->children[1] = std::make_shared<BVHNode>();
-        node->children[1]->boundingBox = BoundingBox(xMedian, node->boundingBox.maxX, node->boundingBox.minY, yMedian,
-                                                     node->boundingBox.minZ, zMedian);
+    return true;
+}
 
-        node->children[2] = std::make_shared<BVHNode>();
-        node->children[2]->boundingBox = BoundingBox(node->boundingBox.minX, xMedian, yMedian, node->boundingBox.maxY,
-                                                     node->boundingBox.minZ, zMedian);
+/**
+ * sets the bounds of every node bottom up, the leaves are fit in parallel and an inner node is fit by the thread
+ * that finishes the second of its children, by then both children are final
+ *
+ * \param nodes - the nodes of the tree, node 0 is the root
+ * \param numNodes - the number of nodes
+ * \param leafBounds - computes the bounds of the primitives of a leaf
+ */
+void BVH::fitNodes(LinearBVHNode *nodes, unsigned int numNodes,
+                   const std::function<BoundingBox(const LinearBVHNode &leaf)> &leafBounds)
+{
+    // the topology does not change until the tree is rebuilt, so the parents are found once
+    if (m_Parents.size() != numNodes)
+    {
+        m_Parents.assign(numNodes, 0);
+        parallelFor(0, numNodes, [&](unsigned int, unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                if (!nodes[i].isLeaf())
+                {
+                    m_Parents[nodes[i].offset] = i;
+                    m_Parents[nodes[i].offset + 1] = i;
+                }
+            }
+        });
+    }
 
-        node->children[3] = std::make_shared<BVHNode>();
-        node->children[3]->boundingBox = BoundingBox(xMedian, node->boundingBox.maxX, yMedian, node->boundingBox.maxY,
-                                                     node->boundingBox.minZ, zMedian);
+    std::vector<std::atomic<uint8_t>> visits(numNodes);
+    parallelFor(0, numNodes, [&](unsigned int, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            if (!nodes[i].isLeaf())
+            {
+                continue;
+            }
 
-        node->children[4] = std::make_shared<BVHNode>();
-        node->children[4]->boundingBox = BoundingBox(node->boundingBox.minX, xMedian, node->boundingBox.minY, yMedian,
-                                                     zMedian, node->boundingBox.maxZ);
+            setNodeBounds(nodes[i], leafBounds(nodes[i]));
 
-        node->children[5] = std::make_shared<BVHNode>();
-        node->children[5]->boundingBox = BoundingBox(xMedian, node->boundingBox.maxX, node->boundingBox.minY, yMedian,
-                                                     zMedian, node->boundingBox.maxZ);
+            uint32_t node = i;
+            while (node != 0 && visits[m_Parents[node]].fetch_add(1, std::memory_order_acq_rel) == 1)
+            {
+                node = m_Parents[node];
+                BoundingBox childBounds = nodeBounds(nodes[nodes[node].offset]);
+                childBounds.grow(nodeBounds(nodes[nodes[node].offset + 1]));
+                setNodeBounds(nodes[node], childBounds);
+            }
+        }
+    });
+}
 
-        node->children[6] = std::make_shared<BVHNode>();
-        node->children[6]->boundingBox = BoundingBox(node->boundingBox.minX, xMedian, yMedian, node->boundingBox.maxY,
-                                                     zMedian, node->boundingBox.maxZ);
+/**
+ * empties the bins of every axis that the build settings use
+ */
+void BVH::clearBins(Bins &bins) const
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (unsigned int b = 0; b < m_Settings.numBins; b++)
+        {
+            bins[axis][b].bounds = BoundingBox::empty();
+            bins[axis][b].numObjects = 0;
+        }
+    }
+}
 
-        node->children[7] = std::make_shared<BVHNode>();
-        node->children[7]->boundingBox = BoundingBox(xMedian, node->boundingBox.maxX, yMedian, node->boundingBox.maxY,
-                                                     zMedian, node->boundingBox.maxZ);
+/**
+ * clears the bins and sorts the objects of a range into them along all three axes
+ */
+void BVH::binRange(unsigned int begin, unsigned int end, const BoundingBox &centerBounds, Bins &bins) const
+{
+    clearBins(bins);
 
-        std::vector<std::shared_ptr<SceneObject>> filteredObjectList;
-        for (std::shared_ptr<BVHNode> child : node->children)
+    BinMapping mapping(centerBounds, m_Settings.numBins);
+    for (unsigned int i = begin; i < end; i++)
+    {
+        const BuildObject &object = m_BuildObjects[i];
+        for (int axis = 0; axis < 3; axis++)
         {
-            filteredObjectList = filterObjects(child, objectList);
-            partitionSpace(child, child->sceneObjects);
+            Bin &bin = bins[axis][mapping.index(object.center, axis)];
+            bin.bounds.grow(object.bounds);
+            bin.numObjects++;
         }
     }
 }
 
-auto BVH::filterObjects(std::shared_ptr<BVHNode> node, std::vector<std::shared_ptr<SceneObject>> objectList)
-    -> std::vector<std::shared_ptr<SceneObject>>
+/**
+ * moves the objects of a range whose centers are in front of the split bin to the front of the range
+ *
+ * in parallel every chunk counts its objects on each side and scatters them into the scratch buffer at the offsets
+ * of the counts before it, so the order of the objects does not depend on the number of threads
+ *
+ * \return - the index of the first object behind the split
+ */
+auto BVH::partitionRange(const BuildRange &range, const BoundingBox &centerBounds, int axis, unsigned int splitBin,
+                         bool parallel) -> unsigned int
 {
-    std::vector<std::shared_ptr<SceneObject>> filteredObjectList;
-    for (std::shared_ptr<SceneObject> object : objectList)
+    BinMapping mapping(centerBounds, m_Settings.numBins);
+    auto inFront = [&](const BuildObject &object) { return mapping.index(object.center, axis) < splitBin; };
+
+    if (!parallel)
     {
-        Vec3 centerPoint = object->getCenterPoint();
-        if (node->boundingBox.inside(centerPoint))
+        auto it = std::partition(m_BuildObjects.begin() + range.begin, m_BuildObjects.begin() + range.end, inFront);
+        return static_cast<unsigned int>(it - m_BuildObjects.begin());
+    }
+
+    unsigned int numChunks = m_ThreadPool->getNumThreads();
+    std::vector<unsigned int> frontCounts(numChunks + 1, 0);
+    std::vector<unsigned int> backCounts(numChunks + 1, 0);
+    parallelFor(range.begin, range.end, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
         {
-            node->sceneObjects.push_back(object);
+            (inFront(m_BuildObjects[i]) ? frontCounts : backCounts)[chunk + 1]++;
         }
-        else
+    });
+
+    // exclusive prefix sums, the back objects go after all front objects
+    for (unsigned int chunk = 0; chunk < numChunks; chunk++)
+    {
+        frontCounts[chunk + 1] += frontCounts[chunk];
+        backCounts[chunk + 1] += backCounts[chunk];
+    }
+    unsigned int mid = range.begin + frontCounts[numChunks];
+
+    m_PartitionScratch.resize(m_BuildObjects.size());
+    parallelFor(range.begin, range.end, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+        unsigned int front = range.begin + frontCounts[chunk];
+        unsigned int back = mid + backCounts[chunk];
+        for (unsigned int i = begin; i < end; i++)
         {
-            filteredObjectList.push_back(object);
+            m_PartitionScratch[inFront(m_BuildObjects[i]) ? front++ : back++] = m_BuildObjects[i];
         }
+    });
+
+    parallelFor(range.begin, range.end, [&](unsigned int, unsigned int begin, unsigned int end) {
+        std::copy(m_PartitionScratch.begin() + begin, m_PartitionScratch.begin() + end, m_BuildObjects.begin() + begin);
+    });
+
+    return mid;
+}
+
+/**
+ * splits an index range into one chunk per thread and runs them on the pool, returns once all chunks are done
+ * must not be called from a task of the pool
+ */
+void BVH::parallelFor(unsigned int begin, unsigned int end,
+                      const std::function<void(unsigned int chunk, unsigned int begin, unsigned int end)> &body)
+{
+    if (!m_ThreadPool)
+    {
+        body(0, begin, end);
+        return;
     }
 
-    return filteredObjectList;
+    unsigned int numChunks = m_ThreadPool->getNumThreads();
+    unsigned int count = end - begin;
+    for (unsigned int chunk = 0; chunk < numChunks; chunk++)
+    {
+        auto chunkBegin = begin + static_cast<unsigned int>(static_cast<uint64_t>(count) * chunk / numChunks);
+        auto chunkEnd = begin + static_cast<unsigned int>(static_cast<uint64_t>(count) * (chunk + 1) / numChunks);
+        m_ThreadPool->submit([&body, chunk, chunkBegin, chunkEnd]() { body(chunk, chunkBegin, chunkEnd); });
+    }
+    m_ThreadPool->wait();
 }
 
 /**
- * encasulates a list of scene objects into a bounding box by finding the
- * minimum and maximum x, y, & z values of their own bounding boxes
+ * finds the closest hit by walking the node array with an explicit stack
  *
- * \param objectList - the list of scene objects to encapsulate
- * \return - the bounding box encapsulating the scene objects
+ * of the two children of a node the one the ray enters first is visited first and the other one is pushed with
+ * its entry time, it is skipped when popped if a hit closer than that time was found in the meantime
  */
-auto BVH::encapsulateObjects(std::vector<std::shared_ptr<SceneObject>> objectList) -> BoundingBox
+auto BVH::rayIntersect(Ray ray) const -> Hit
 {
-    const float floatMin = std::numeric_limits<float>::min();
-    const float floatMax = std::numeric_limits<float>::max();
+    PrimitiveHit closest = closestPrimitiveHit(ray);
 
-    float minX = floatMax;
-    float minY = floatMax;
-    float minZ = floatMax;
+    // only the closest hit gets its position, normal and material
+    if (closest.time == INFINITY)
+    {
+        return Hit();
+    }
+    return m_OjectList[closest.object]->shadeHit(ray, closest);
+}
 
-    float maxX = floatMin;
-    float maxY = floatMin;
-    float maxZ = floatMin;
+auto BVH::closestPrimitiveHit(Ray ray, float maxTime) const -> PrimitiveHit
+{
+    if (m_WideBVH8)
+    {
+        return m_WideBVH8->closestHit(ray, maxTime);
+    }
+    if (m_WideBVH4)
+    {
+        return m_WideBVH4->closestHit(ray, maxTime);
+    }
+    return closestHit(ray, maxTime);
+}
 
-    // Get bounding box of each scene object to find bounding box of all objects
-    for (std::shared_ptr<SceneObject> so : objectList)
+/**
+ * finds the closest primitive the ray hits in the binary tree
+ */
+auto BVH::closestHit(Ray ray, float maxTime) const -> PrimitiveHit
+{
+    PrimitiveHit hit;
+    hit.time = maxTime;
+    if (m_Nodes.empty())
     {
-        minX = std::min(minX, so->getMinX());
-        minY = std::min(minY, so->getMinY());
-        minZ = std::min(minZ, so->getMinZ());
+        return hit;
+    }
 
-        maxX = std::max(maxX, so->getMaxX());
-        maxY = std::max(maxY, so->getMaxY());
-        maxZ = std::max(maxZ, so->getMaxZ());
+    TraversalRay traversalRay(ray);
+    const float *org = traversalRay.org;
+    const float *invDir = traversalRay.invDir;
+
+    struct StackEntry
+    {
+        uint32_t nodeIndex;
+        float entryTime;
+    };
+    StackEntry stack[maxDepth];
+    unsigned int stackSize = 0;
+
+    float entryTime = 0.0f;
+    if (!m_Nodes[0].rayEntry(org, invDir, hit.time, entryTime))
+    {
+        return hit;
     }
 
-    return {minX, maxX, minY, maxY, minZ, maxZ};
+    uint32_t nodeIndex = 0;
+    while (true)
+    {
+        const LinearBVHNode &node = m_Nodes[nodeIndex];
+        if (node.isLeaf())
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.numObjects; i++)
+            {
+                const PrimitiveRef &primitive = m_Primitives[i];
+                if (m_OjectList[primitive.object]->rayIntersect(ray, primitive.primitive, hit))
+                {
+                    hit.object = primitive.object;
+                    hit.primitive = primitive.primitive;
+                }
+            }
+        }
+        else
+        {
+            uint32_t near = node.offset;
+            uint32_t far = node.offset + 1;
+            float nearTime = 0.0f;
+            float farTime = 0.0f;
+            bool hitNear = m_Nodes[near].rayEntry(org, invDir, hit.time, nearTime);
+            bool hitFar = m_Nodes[far].rayEntry(org, invDir, hit.time, farTime);
+
+            if (hitNear && hitFar)
+            {
+                if (farTime < nearTime)
+                {
+                    std::swap(near, far);
+                    std::swap(nearTime, farTime);
+                }
+
+                stack[stackSize++] = {far, farTime};
+                nodeIndex = near;
+                continue;
+            }
+
+            if (hitNear || hitFar)
+            {
+                nodeIndex = hitNear ? near : far;
+                continue;
+            }
+        }
+
+        // pop the next subtree the ray enters before the closest hit
+        do
+        {
+            if (stackSize == 0)
+            {
+                return hit;
+            }
+            stackSize--;
+        } while (stack[stackSize].entryTime > hit.time);
+
+        nodeIndex = stack[stackSize].nodeIndex;
+    }
+}
+
+auto BVH::rayOccluded(Ray ray, float maxTime) const -> bool
+{
+    if (m_Nodes.empty())
+    {
+        return false;
+    }
+
+    if (m_WideBVH8)
+    {
+        return m_WideBVH8->rayOccluded(ray, maxTime);
+    }
+    if (m_WideBVH4)
+    {
+        return m_WideBVH4->rayOccluded(ray, maxTime);
+    }
+
+    TraversalRay traversalRay(ray);
+
+    // any blocker ends the search so the children are visited in memory order
+    uint32_t stack[maxDepth + 1];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const LinearBVHNode &node = m_Nodes[stack[--stackSize]];
+        float entryTime = 0.0f;
+        if (!node.rayEntry(traversalRay.org, traversalRay.invDir, maxTime, entryTime))
+        {
+            continue;
+        }
+
+        if (node.isLeaf())
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.numObjects; i++)
+            {
+                const PrimitiveRef &primitive = m_Primitives[i];
+                if (m_OjectList[primitive.object]->rayOccluded(ray, primitive.primitive, maxTime))
+                {
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            stack[stackSize++] = node.offset + 1;
+            stack[stackSize++] = node.offset;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * sets the bounds of a flattened node
+ */
+void BVH::setNodeBounds(LinearBVHNode &node, const BoundingBox &bounds)
+{
+    node.boundsMin[0] = bounds.minX;
+    node.boundsMin[1] = bounds.minY;
+    node.boundsMin[2] = bounds.minZ;
+    node.boundsMax[0] = bounds.maxX;
+    node.boundsMax[1] = bounds.maxY;
+    node.boundsMax[2] = bounds.maxZ;
+}
+
+/**
+ * the bounds of a flattened node
+ */
+auto BVH::nodeBounds(const LinearBVHNode &node) -> BoundingBox
+{
+    return {node.boundsMin[0], node.boundsMax[0], node.boundsMin[1],
+            node.boundsMax[1], node.boundsMin[2], node.boundsMax[2]};
 }
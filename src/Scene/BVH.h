@@ -1,76 +1,443 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <iostream>
-#include <iterator>
-#include <limits>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "BoundingBox.h"
 #include "SceneObject.h"
+#include "Utils/DataBuffer.h"
 
-struct BVHNode
+class ThreadPool;
+
+template <unsigned int Width> class WideBVH;
+
+/**
+ * the ways a bounding volume heirarchy can be built
+ */
+enum class BVHBuilder
 {
-    BoundingBox boundingBox;
-    std::vector<std::shared_ptr<BVHNode>> children;
-    bool isLeaf;
-    std::vector<std::shared_ptr<SceneObject>> sceneObjects;
+    // splits every node where the surface area heuristic is lowest, the fastest tree to trace
+    SAH,
+
+    // sorts the primitives along a Morton curve and splits the sorted list at the bits of their codes, builds many
+    // times faster than SAH for a tree that is slower to trace
+    Morton
+};
+
+/**
+ * \param name - "sah" or "morton"
+ */
+auto parseBVHBuilder(const std::string &name) -> BVHBuilder;
+
+/**
+ * the parameters of the bounding volume heirarchy construction
+ */
+struct BVHBuildSettings
+{
+    // a node with more objects than this is always split
+    unsigned int maxObjectsInLeaf = 10;
+
+    // surface area heuristic cost of visiting a node and of intersecting one object
+    float traversalCost = 1.0f;
+    float intersectionCost = 1.0f;
+
+    // number of buckets the object centers are sorted into to find the best split
+    unsigned int numBins = 16;
 
-    BVHNode() : isLeaf(false)
+    // children per node the binary tree is collapsed into for traversal, 2 keeps the binary tree
+    // and 0 picks 8 or 4 by the vector instructions of the CPU
+    unsigned int width = 0;
+
+    // BVH::update rebuilds a refit tree once its surface area heuristic cost grows past this multiple of its cost
+    // after the last build
+    float rebuildCostRatio = 1.5f;
+
+    // how the nodes are split, the costs and bins only matter to SAH builds
+    BVHBuilder builder = BVHBuilder::SAH;
+};
+
+/**
+ * a ray prepared for slab tests against node bounds
+ */
+struct TraversalRay
+{
+    float org[3];
+    float invDir[3];
+
+    // the ray enters a box through its max plane on an axis it travels down
+    bool dirNegative[3];
+
+    explicit TraversalRay(const Ray &ray)
     {
+        // a zero direction component is nudged so the slab times are infinite instead of nan
+        float dir[3] = {ray.dir.x, ray.dir.y, ray.dir.z};
+        float rayOrg[3] = {ray.org.x, ray.org.y, ray.org.z};
+        for (int axis = 0; axis < 3; axis++)
+        {
+            org[axis] = rayOrg[axis];
+            invDir[axis] = 1.0f / (std::fabs(dir[axis]) > 1e-20f ? dir[axis] : std::copysign(1e-20f, dir[axis]));
+            dirNegative[axis] = invDir[axis] < 0.0f;
+        }
     }
+};
 
-    Hit rayIntersect(Ray ray)
+/**
+ * a primitive of a scene object, the leaves of the BVH refer to ranges of these
+ */
+struct PrimitiveRef
+{
+    uint32_t object;
+    uint32_t primitive;
+};
+
+/**
+ * a node of the BVH, two nodes share a 64 byte cache line
+ *
+ * the two children of an inner node are stored next to each other so both are loaded together when the ray is
+ * tested against them, the offset is the index of the first child for inner nodes and of the first primitive for
+ * leaves, numObjects is the number of primitives of a leaf
+ */
+struct alignas(32) LinearBVHNode
+{
+    float boundsMin[3];
+    uint32_t offset;
+    float boundsMax[3];
+    uint32_t numObjects;
+
+    auto inline isLeaf() const -> bool
     {
-        Hit hit;
+        return numObjects > 0;
+    }
 
-        if (isLeaf)
-        {
-            for (std::shared_ptr<SceneObject> so : sceneObjects)
-            {
-                Hit curHit = so->rayIntersect(ray);
-                if (curHit.isHit && hit.time > curHit.time)
-                {
-                    hit = curHit;
-                }
-            }
-        }
-        else
+    /**
+     * slab test against the node's bounds
+     *
+     * \param org - the origin of the ray
+     * \param invDir - the reciprocal of each component of the ray direction
+     * \param maxTime - the time of the closest hit found so far
+     * \param entryTime - set to the time the ray enters the bounds
+     * \return - true if the ray enters the bounds between its origin and maxTime
+     */
+    auto inline rayEntry(const float org[3], const float invDir[3], float maxTime, float &entryTime) const -> bool
+    {
+        float tEnter = 0.0f;
+        float tExit = maxTime;
+        for (int axis = 0; axis < 3; axis++)
         {
-            for (std::shared_ptr<BVHNode> child : children)
-            {
-                Hit curHit = child->rayIntersect(ray);
-                if (curHit.isHit && hit.time > curHit.time)
-                {
-                    hit = curHit;
-                }
-            }
+            float t0 = (boundsMin[axis] - org[axis]) * invDir[axis];
+            float t1 = (boundsMax[axis] - org[axis]) * invDir[axis];
+            tEnter = std::max(tEnter, std::min(t0, t1));
+            tExit = std::min(tExit, std::max(t0, t1));
         }
 
-        return hit;
+        entryTime = tEnter;
+        return tEnter <= tExit;
     }
 };
 
+static_assert(sizeof(LinearBVHNode) == 32, "a BVH node should fill half a cache line");
+
+/**
+ * a node of a wide BVH, the bounds of all its children are stored axis by axis so one vector instruction tests
+ * the same plane of every child box
+ *
+ * a child with objects is a leaf and child is the index of its first primitive, otherwise child is the index of a
+ * wide node, unused slots have inverted bounds that no ray enters
+ */
+template <unsigned int Width> struct alignas(64) WideBVHNode
+{
+    float boundsMin[3][Width];
+    float boundsMax[3][Width];
+    uint32_t child[Width];
+    uint32_t numObjects[Width];
+};
+
+static_assert(sizeof(WideBVHNode<4>) == 128, "a 4 wide BVH node should fill two cache lines");
+static_assert(sizeof(WideBVHNode<8>) == 256, "an 8 wide BVH node should fill four cache lines");
+
+/**
+ * the arrays of a BVH that was built before, like the ones stored in a scene cache
+ */
+struct BVHData
+{
+    DataBuffer<LinearBVHNode> nodes;
+    DataBuffer<PrimitiveRef> primitives;
+
+    // the wide tree the binary one was collapsed into, the binary tree is collapsed again if the one with the width
+    // rays are traced with is empty
+    DataBuffer<WideBVHNode<4>> wideNodes4;
+    DataBuffer<WideBVHNode<8>> wideNodes8;
+};
+
 /**
- * bounding volume heirarchy (octree) used as an acceleration structure
- * to speed up ray-scene intersection tests
+ * binary bounding volume heirarchy built with the surface area heuristic or along a Morton curve
+ * used as an acceleration structure to speed up ray-scene intersection tests
+ *
+ * the tree is built over the primitives of the objects, so a mesh is split into its triangles
+ *
+ * after the build the binary tree is collapsed into a 4 or 8 wide tree whose child boxes are tested together
  */
 class BVH
 {
   public:
-    BVH(std::vector<std::shared_ptr<SceneObject>> objectList, unsigned int objectsInLeaf = 10);
-    std::shared_ptr<BVHNode> root;
+    BVH(std::vector<std::shared_ptr<SceneObject>> objectList, const BVHBuildSettings &settings = {},
+        ThreadPool *threadPool = nullptr);
 
-  private:
-    void partitionSpace(std::shared_ptr<BVHNode> root, std::vector<std::shared_ptr<SceneObject>> objectList);
-    auto encapsulateObjects(std::vector<std::shared_ptr<SceneObject>> objectList) -> BoundingBox;
-    auto filterObjects(std::shared_ptr<BVHNode>, std::vector<std::shared_ptr<SceneObject>> objectList)
-        -> std::vector<std::shared_ptr<SceneObject>>;
+    /**
+     * creates a BVH from arrays that were built before
+     *
+     * \param objectList - the objects the primitives refer to, in the order the BVH was built with
+     * \param data - the flattened binary tree whose node 0 is the root, the primitives its leaves refer to and the
+     * wide tree collapsed from it
+     * \param settings - the settings the BVH was built with, only the costs and width are used
+     */
+    BVH(std::vector<std::shared_ptr<SceneObject>> objectList, BVHData data, const BVHBuildSettings &settings = {});
+    ~BVH();
 
-  public:
-    std::vector<BoundingBox> m_BoundingBoxes{};
+    /**
+     * finds the closest intersection of a ray with the objects in the BVH
+     *
+     * \param ray - the ray to intersect
+     * \return - the closest hit, isHit is false if the ray hits nothing
+     */
+    auto rayIntersect(Ray ray) const -> Hit;
+
+    /**
+     * finds the closest primitive a ray hits before a given time, the hit is not shaded
+     *
+     * \param ray - the ray to intersect
+     * \param maxTime - primitives hit after this time are ignored
+     * \return - the closest hit, its time is INFINITY if the ray hits nothing before maxTime
+     */
+    auto closestPrimitiveHit(Ray ray, float maxTime = INFINITY) const -> PrimitiveHit;
+
+    /**
+     * checks if any object blocks a ray before a given time, the search stops at the first blocker found
+     *
+     * \param ray - the ray to test
+     * \param maxTime - objects hit after this time do not block the ray
+     * \return - true if an object is hit at or before maxTime
+     */
+    auto rayOccluded(Ray ray, float maxTime) const -> bool;
+
+    /**
+     * recomputes the bounds of the nodes from the current bounds of the primitives, for objects that moved or
+     * changed shape since the tree was built
+     *
+     * the leaves are refit in parallel and an inner node is refit by the thread that finishes the second of its
+     * children, the tree keeps its topology so its quality drops the further the primitives move, must not be
+     * called while rays are traced
+     *
+     * \param threadPool - the pool that refits the tree, it is refit on the calling thread if this is null
+     */
+    void refit(ThreadPool *threadPool = nullptr);
+
+    /**
+     * builds the tree again over the current bounds of the primitives, the BVH is rebuilt in place so pointers to
+     * it stay valid, must not be called while rays are traced
+     */
+    void rebuild(ThreadPool *threadPool = nullptr);
+
+    /**
+     * refits the tree and rebuilds it if its surface area heuristic cost grew past rebuildCostRatio times its cost
+     * after the last build
+     *
+     * \return - true if the tree was rebuilt
+     */
+    auto update(ThreadPool *threadPool = nullptr) -> bool;
+
+    auto inline getNumNodes() const -> unsigned int
+    {
+        return m_NumNodes;
+    }
+
+    auto inline getNodes() const -> const DataBuffer<LinearBVHNode> &
+    {
+        return m_Nodes;
+    }
+
+    auto inline getPrimitives() const -> const DataBuffer<PrimitiveRef> &
+    {
+        return m_Primitives;
+    }
+
+    /**
+     * the wide tree rays are traced with, null unless the width is 4 or 8
+     */
+    auto inline getWideBVH4() const -> const WideBVH<4> *
+    {
+        return m_WideBVH4.get();
+    }
+
+    auto inline getWideBVH8() const -> const WideBVH<8> *
+    {
+        return m_WideBVH8.get();
+    }
+
+    auto inline getNumLeaves() const -> unsigned int
+    {
+        return m_NumLeaves;
+    }
+
+    /**
+     * the number of children per node rays are traced with
+     */
+    auto inline getWidth() const -> unsigned int
+    {
+        return m_Width;
+    }
+
+    /**
+     * the wall clock time the build took in milliseconds
+     */
+    auto inline getBuildTime() const -> double
+    {
+        return m_BuildTime;
+    }
+
+    /**
+     * the expected cost of a random ray that hits the root box, in the units of the build settings
+     */
+    auto inline getSAHCost() const -> float
+    {
+        return m_SAHCost;
+    }
+
+    /**
+     * the surface area heuristic cost of the tree right after it was last built
+     */
+    auto inline getBuildSAHCost() const -> float
+    {
+        return m_BuildSAHCost;
+    }
+
+    /**
+     * the deepest a node can be, deeper ranges are made into leaves so traversal fits a fixed stack
+     */
+    static constexpr unsigned int maxDepth = 64;
+
+    /**
+     * the most bins a split is searched with
+     */
+    static constexpr unsigned int maxBins = 16;
+
+    /**
+     * ranges with at least this many objects are binned and partitioned by all threads together
+     */
+    static constexpr unsigned int parallelRangeSize = 1U << 16;
+
+    /**
+     * subtrees with at least this many objects are built by a task of their own
+     */
+    static constexpr unsigned int taskRangeSize = 1U << 11;
+
+    /**
+     * Morton builds over at least this many objects sort 63 bit codes instead of 30 bit ones, so nearby primitives
+     * of large meshes still get codes of their own
+     */
+    static constexpr unsigned int longMortonCodeSize = 1U << 18;
+
+    /**
+     * the most objects a leaf of a Morton build holds, the leaves can not be sized by their cost without bounds
+     */
+    static constexpr unsigned int maxMortonLeafSize = 4;
 
   private:
+    /**
+     * a primitive's bounds and center cached for the build
+     */
+    struct BuildObject
+    {
+        BoundingBox bounds;
+        Vec3 center;
+        unsigned int primitiveIndex;
+    };
+
+    /**
+     * a node waiting to be built from a range of the build objects
+     */
+    struct BuildRange
+    {
+        uint32_t nodeIndex;
+        unsigned int begin, end;
+        unsigned int depth;
+        BoundingBox bounds;
+    };
+
+    /**
+     * the objects whose centers fall into one bin of one axis
+     * bins are cleared by clearBins, only the bins in use are touched
+     */
+    struct Bin
+    {
+        BoundingBox bounds;
+        unsigned int numObjects;
+    };
+
+    using Bins = Bin[3][maxBins];
+
+    /**
+     * a build object's position along the Morton curve through the center bounds
+     */
+    struct MortonPrimitive
+    {
+        uint64_t code;
+        uint32_t index;
+    };
+
+    void build();
+    void measureTree();
+    void printTree() const;
+    void createWideBVH(DataBuffer<WideBVHNode<4>> wideNodes4 = {}, DataBuffer<WideBVHNode<8>> wideNodes8 = {});
+
+    void buildTopLevels(const BuildRange &root, std::vector<BuildRange> &subtrees);
+    void buildSubtree(BuildRange range);
+    auto splitRange(const BuildRange &range, BuildRange children[2], bool parallel) -> bool;
+
+    void buildMorton(const BuildRange &root);
+    void sortMortonPrimitives(unsigned int numCodeBits);
+    auto splitMortonRange(const BuildRange &range, BuildRange children[2]) -> bool;
+    void fitNodes(LinearBVHNode *nodes, unsigned int numNodes,
+                  const std::function<BoundingBox(const LinearBVHNode &leaf)> &leafBounds);
+
+    void clearBins(Bins &bins) const;
+    void binRange(unsigned int begin, unsigned int end, const BoundingBox &centerBounds, Bins &bins) const;
+    auto partitionRange(const BuildRange &range, const BoundingBox &centerBounds, int axis, unsigned int splitBin,
+                        bool parallel) -> unsigned int;
+    void parallelFor(unsigned int begin, unsigned int end,
+                     const std::function<void(unsigned int chunk, unsigned int begin, unsigned int end)> &body);
+
+    auto closestHit(Ray ray, float maxTime) const -> PrimitiveHit;
+
+    static auto nodeBounds(const LinearBVHNode &node) -> BoundingBox;
+    static void setNodeBounds(LinearBVHNode &node, const BoundingBox &bounds);
+
     std::vector<std::shared_ptr<SceneObject>> m_OjectList{};
-    unsigned int m_ObjectsInLeaf;
+    DataBuffer<PrimitiveRef> m_Primitives{};
+    DataBuffer<LinearBVHNode> m_Nodes{};
+    std::vector<BuildObject> m_BuildObjects{};
+    std::vector<BuildObject> m_PartitionScratch{};
+    std::vector<LinearBVHNode> m_BuildNodes{};
+    std::vector<MortonPrimitive> m_MortonPrimitives{};
+
+    // the parent of every node, found by the Morton build or the first refit
+    std::vector<uint32_t> m_Parents{};
+    std::unique_ptr<WideBVH<4>> m_WideBVH4;
+    std::unique_ptr<WideBVH<8>> m_WideBVH8;
+    unsigned int m_Width = 2;
+    std::atomic<uint32_t> m_NextNode = 0;
+    BVHBuildSettings m_Settings;
+    ThreadPool *m_ThreadPool;
+
+    unsigned int m_NumNodes = 0;
+    unsigned int m_NumLeaves = 0;
+    float m_SAHCost = 0.0f;
+    float m_BuildSAHCost = 0.0f;
+    double m_BuildTime = 0.0;
 };
@@ -3,6 +3,8 @@
 #include "RayTracer/Ray.h"
 #include "SceneObject.h"
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 #include <vector>
 
@@ -49,6 +51,93 @@ struct BoundingBox
         }
     }
 
+    /**
+     * returns a box that contains nothing, growing it by anything gives the bounds of that thing
+     */
+    static auto empty() -> BoundingBox
+    {
+        const float floatMax = std::numeric_limits<float>::max();
+        return {floatMax, -floatMax, floatMax, -floatMax, floatMax, -floatMax};
+    }
+
+    /**
+     * returns the bounds of a primitive of a scene object
+     */
+    static auto of(SceneObject &object, unsigned int primitive) -> BoundingBox
+    {
+        Vec3 min;
+        Vec3 max;
+        object.getPrimitiveBounds(primitive, min, max);
+        return {min.x, max.x, min.y, max.y, min.z, max.z};
+    }
+
+    /**
+     * enlarges the box so it also contains another box
+     */
+    void grow(const BoundingBox &box)
+    {
+        // working on copies tells the compiler the boxes cannot overlap, so it uses min/max instructions, not branches
+        BoundingBox a = *this;
+        BoundingBox b = box;
+
+        minX = std::min(a.minX, b.minX);
+        minY = std::min(a.minY, b.minY);
+        minZ = std::min(a.minZ, b.minZ);
+
+        maxX = std::max(a.maxX, b.maxX);
+        maxY = std::max(a.maxY, b.maxY);
+        maxZ = std::max(a.maxZ, b.maxZ);
+    }
+
+    /**
+     * enlarges the box so it also contains a point
+     */
+    void grow(const Vec3 &point)
+    {
+        BoundingBox a = *this;
+        Vec3 p = point;
+
+        minX = std::min(a.minX, p.x);
+        minY = std::min(a.minY, p.y);
+        minZ = std::min(a.minZ, p.z);
+
+        maxX = std::max(a.maxX, p.x);
+        maxY = std::max(a.maxY, p.y);
+        maxZ = std::max(a.maxZ, p.z);
+    }
+
+    /**
+     * the surface area of the box, 0 for an empty box
+     */
+    auto surfaceArea() const -> float
+    {
+        float dx = maxX - minX;
+        float dy = maxY - minY;
+        float dz = maxZ - minZ;
+        if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+        {
+            return 0.0f;
+        }
+
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+
+    /**
+     * the minimum (axis 0, 1, 2 for x, y, z) coordinate of the box
+     */
+    auto getMin(int axis) const -> float
+    {
+        return axis == 0 ? minX : (axis == 1 ? minY : minZ);
+    }
+
+    /**
+     * the maximum (axis 0, 1, 2 for x, y, z) coordinate of the box
+     */
+    auto getMax(int axis) const -> float
+    {
+        return axis == 0 ? maxX : (axis == 1 ? maxY : maxZ);
+    }
+
     bool inside(Vec3 point)
     {
         if (point.x < minX || point.x > maxX)
@@ -1,5 +1,8 @@
 #include "Light.h"
 
+#include <algorithm>
+#include <cmath>
+
 /**
  * creates a point light
  *
@@ -16,3 +19,95 @@ PointLight::PointLight(Vec3 pos, Vec3 color, float i, float radius)
     m_Intensity = i;
     m_Radius = radius;
 }
+
+auto Light::getRadiance() const -> Vec3
+{
+    return m_Color * (m_Intensity / (PI * m_Radius * m_Radius));
+}
+
+/**
+ * picks a direction uniformly from the cone of directions in which the light's sphere is seen, so every sample lands
+ * on the visible side of the sphere and the density is constant over the cone
+ */
+auto Light::sample(const Vec3 &pos, float u1, float u2, LightSample &sample) const -> bool
+{
+    Vec3 toCenter = m_Pos - pos;
+    float dist2 = toCenter.dot(toCenter);
+
+    if (isPoint())
+    {
+        sample.dist = sqrtf(dist2);
+        sample.dir = toCenter * (1.0f / sample.dist);
+        sample.pdf = 1.0f;
+        sample.radiance = m_Color * (m_Intensity / dist2);
+        return true;
+    }
+
+    // a position inside the light sees it in every direction
+    float radius2 = m_Radius * m_Radius;
+    if (dist2 <= radius2)
+    {
+        return false;
+    }
+
+    // 1 - cos is computed from sin^2 so it keeps its precision for small and distant lights
+    float sinMax2 = radius2 / dist2;
+    float oneMinusCosMax = sinMax2 / (1.0f + sqrtf(1.0f - sinMax2));
+
+    float oneMinusCos = u1 * oneMinusCosMax;
+    float cosTheta = 1.0f - oneMinusCos;
+    float sinTheta = sqrtf(std::max(0.0f, oneMinusCos * (2.0f - oneMinusCos)));
+    float phi = 2.0f * PI * u2;
+
+    float dist = sqrtf(dist2);
+    sample.dir = toWorld(toCenter * (1.0f / dist), sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+
+    // the distance to where the direction enters the sphere
+    float tca = dist * cosTheta;
+    float d2 = std::max(0.0f, dist2 - tca * tca);
+    sample.dist = tca - sqrtf(std::max(0.0f, radius2 - d2));
+
+    sample.pdf = 1.0f / (2.0f * PI * oneMinusCosMax);
+    sample.radiance = getRadiance();
+    return true;
+}
+
+auto Light::pdf(const Vec3 &pos, const Vec3 &dir) const -> float
+{
+    if (isPoint() || rayHitTime(Ray(pos, dir)) == INFINITY)
+    {
+        return 0.0f;
+    }
+
+    Vec3 toCenter = m_Pos - pos;
+    float sinMax2 = (m_Radius * m_Radius) / toCenter.dot(toCenter);
+    float oneMinusCosMax = sinMax2 / (1.0f + sqrtf(1.0f - sinMax2));
+    return 1.0f / (2.0f * PI * oneMinusCosMax);
+}
+
+auto Light::rayHitTime(const Ray &ray) const -> float
+{
+    if (isPoint())
+    {
+        return INFINITY;
+    }
+
+    // the ray direction is a unit vector
+    Vec3 toCenter = m_Pos - ray.org;
+    float tca = toCenter.dot(ray.dir);
+    float d2 = toCenter.dot(toCenter) - tca * tca;
+    float radius2 = m_Radius * m_Radius;
+    if (d2 > radius2)
+    {
+        return INFINITY;
+    }
+
+    float thc = sqrtf(radius2 - d2);
+    if (tca - thc > 0.0f)
+    {
+        return tca - thc;
+    }
+
+    // a ray starting inside the light never reaches the light's surface from outside
+    return INFINITY;
+}
@@ -1,29 +1,85 @@
 #pragma once
+#include "RayTracer/Ray.h"
 #include "Utils/Vec3.h"
 
+/**
+ * a direction towards a light chosen by Light::sample
+ */
+struct LightSample
+{
+    // unit direction from the lit position to the sampled point of the light
+    Vec3 dir;
+
+    // distance to the sampled point, shadow rays stop there
+    float dist = 0.0f;
+
+    // solid angle density of the direction, 1 for a point light which can only be sampled one way
+    float pdf = 0.0f;
+
+    // the light arriving along the direction, for a point light already divided by the squared distance
+    Vec3 radiance;
+};
+
 /**
  * the base class for all lights in the scene
  */
 class Light
 {
   public:
-    auto inline getPos() -> Vec3
+    auto inline getPos() const -> Vec3
     {
         return m_Pos;
     };
-    auto inline getColor() -> Vec3
+    auto inline getColor() const -> Vec3
     {
         return m_Color;
     };
-    auto inline getIntensity() -> Vec3
+    auto inline getIntensity() const -> Vec3
     {
         return m_Intensity;
     };
-    auto inline getRadius() -> float
+    auto inline getRadius() const -> float
     {
         return m_Radius;
     };
 
+    /**
+     * a light without a radius is a point that can only be found by sampling it, never by a ray
+     */
+    auto inline isPoint() const -> bool
+    {
+        return m_Radius <= 0.0f;
+    }
+
+    /**
+     * the radiance leaving the surface of the light's sphere, so the sphere sends out as much light as a point light
+     * of the light's color times its intensity
+     */
+    auto getRadiance() const -> Vec3;
+
+    /**
+     * picks a point on the light to send a shadow ray to
+     *
+     * \param pos - the position being lit
+     * \param u1, u2 - uniform random numbers in [0, 1)
+     * \param sample - set to the direction, distance, density and radiance of the picked point
+     * \return - false if pos is inside the light's sphere
+     */
+    auto sample(const Vec3 &pos, float u1, float u2, LightSample &sample) const -> bool;
+
+    /**
+     * the solid angle density with which sample picks a direction, 0 if the direction misses the light
+     *
+     * \param pos - the position being lit
+     * \param dir - the unit direction from pos
+     */
+    auto pdf(const Vec3 &pos, const Vec3 &dir) const -> float;
+
+    /**
+     * the time a ray enters the light's sphere, INFINITY if it misses or the light is a point
+     */
+    auto rayHitTime(const Ray &ray) const -> float;
+
   protected:
     Vec3 m_Pos;
     Vec3 m_Color;
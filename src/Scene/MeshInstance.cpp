@@ -0,0 +1,142 @@
+#include "MeshInstance.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * places a mesh in the scene
+ *
+ * \param mesh - the mesh that is placed
+ * \param objectToWorld - the transform from the space of the mesh into the scene
+ */
+MeshInstance::MeshInstance(std::shared_ptr<TriangleMesh> mesh, const Transform &objectToWorld)
+    : m_Mesh(std::move(mesh))
+{
+    setTransform(objectToWorld);
+}
+
+void MeshInstance::setTransform(const Transform &objectToWorld)
+{
+    m_ObjectToWorld = objectToWorld;
+    m_WorldToObject = objectToWorld.inverse();
+    updateBounds();
+}
+
+/**
+ * encloses the transformed corners of the mesh's bounds
+ */
+void MeshInstance::updateBounds()
+{
+    minX = minY = minZ = INFINITY;
+    maxX = maxY = maxZ = -INFINITY;
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        Vec3 point((corner & 1) ? m_Mesh->getMaxX() : m_Mesh->getMinX(),
+                   (corner & 2) ? m_Mesh->getMaxY() : m_Mesh->getMinY(),
+                   (corner & 4) ? m_Mesh->getMaxZ() : m_Mesh->getMinZ());
+        point = m_ObjectToWorld.applyPoint(point);
+
+        minX = std::min(minX, point.x);
+        minY = std::min(minY, point.y);
+        minZ = std::min(minZ, point.z);
+
+        maxX = std::max(maxX, point.x);
+        maxY = std::max(maxY, point.y);
+        maxZ = std::max(maxZ, point.z);
+    }
+}
+
+void MeshInstance::setBVH(std::shared_ptr<const BVH> bvh)
+{
+    m_BVH = std::move(bvh);
+}
+
+/**
+ * moves a ray into the space of the mesh
+ *
+ * the direction is not normalized again, so a point reached at some time along the returned ray is the point
+ * reached at the same time along the ray in the scene and hit times need no conversion
+ */
+auto MeshInstance::toObjectSpace(const Ray &ray) const -> Ray
+{
+    Ray objectRay;
+    objectRay.org = m_WorldToObject.applyPoint(ray.org);
+    objectRay.dir = m_WorldToObject.applyVector(ray.dir);
+    return objectRay;
+}
+
+/**
+ * records the closest hit of a ray with a triangle of the mesh if it is closer than the closest hit so far
+ *
+ * \param ray - the ray in the space of the scene
+ * \param primitive - unused, the instance is a single primitive
+ * \param closest - the closest hit so far, instancePrimitive is set to the triangle that was hit
+ * \return - true if a triangle of the mesh is the new closest hit
+ */
+auto MeshInstance::rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) -> bool
+{
+    PrimitiveHit hit = m_BVH->closestPrimitiveHit(toObjectSpace(ray), closest.time);
+    if (hit.time < closest.time)
+    {
+        closest.time = hit.time;
+        closest.u = hit.u;
+        closest.v = hit.v;
+        closest.instancePrimitive = hit.primitive;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * shades the hit triangle in the space of the mesh and moves the hit back into the scene
+ *
+ * normals are transformed by the transposed inverse of the instance's transform so they stay perpendicular to a
+ * surface that was scaled unevenly
+ *
+ * \param ray - the ray in the space of the scene
+ * \param primitiveHit - the hit recorded by rayIntersect
+ * \return - the hit with the instance's material
+ */
+auto MeshInstance::shadeHit(Ray ray, const PrimitiveHit &primitiveHit) -> Hit
+{
+    PrimitiveHit meshHit = primitiveHit;
+    meshHit.object = 0;
+    meshHit.primitive = primitiveHit.instancePrimitive;
+
+    Hit hit = m_Mesh->shadeHit(toObjectSpace(ray), meshHit);
+    hit.position = ray.posAt(primitiveHit.time);
+    hit.normal = m_WorldToObject.applyTransposed(hit.normal);
+    hit.normal.normalize();
+    hit.materialId = m_MaterialId;
+    return hit;
+}
+
+/**
+ * calculates the time a ray first hits a triangle of the mesh
+ *
+ * \return - the time of the intersection in the space of the scene, INFINITY if the ray misses the mesh
+ */
+auto MeshInstance::rayHitTime(Ray ray, unsigned int primitive) -> float
+{
+    return m_BVH->closestPrimitiveHit(toObjectSpace(ray)).time;
+}
+
+/**
+ * checks if any triangle of the mesh blocks a ray at or before maxTime, the search stops at the first blocker
+ */
+auto MeshInstance::rayOccluded(Ray ray, unsigned int primitive, float maxTime) -> bool
+{
+    return m_BVH->rayOccluded(toObjectSpace(ray), maxTime);
+}
+
+/**
+ * calculates the center of the instance's bounds
+ *
+ * \return - the center point as a Vec3
+ */
+auto MeshInstance::getCenterPoint() -> Vec3
+{
+    return Vec3((minX + maxX) / 2.0f, (minY + maxY) / 2.0f, (minZ + maxZ) / 2.0f);
+}
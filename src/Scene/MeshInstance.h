@@ -0,0 +1,59 @@
+#pragma once
+#include <memory>
+
+#include "BVH.h"
+#include "SceneObject.h"
+#include "Utils/Transform.h"
+
+/**
+ * a placement of a triangle mesh in the scene with its own transform and material
+ *
+ * the instance is a single primitive of the top level BVH, rays that reach it are moved into the space of the
+ * mesh and traverse a bottom level BVH that is built once and shared by every instance of the mesh, so the
+ * triangles of a model are stored once no matter how often it is placed
+ */
+class MeshInstance : public SceneObject
+{
+  public:
+    ~MeshInstance() override = default;
+
+    /**
+     * \param mesh - the mesh that is placed, it can be shared with other instances
+     * \param objectToWorld - the transform from the space of the mesh into the scene
+     */
+    MeshInstance(std::shared_ptr<TriangleMesh> mesh, const Transform &objectToWorld);
+
+    /**
+     * sets the BVH over the triangles of the mesh, rays are traced against it once it is set
+     */
+    void setBVH(std::shared_ptr<const BVH> bvh);
+
+    /**
+     * moves the instance, the BVH the instance is in has to be refit afterwards
+     */
+    void setTransform(const Transform &objectToWorld);
+
+    /**
+     * bounds the transformed mesh again, after the vertices of the mesh were moved
+     */
+    void updateBounds();
+
+    bool rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) override;
+    Hit shadeHit(Ray ray, const PrimitiveHit &primitiveHit) override;
+    Vec3 getCenterPoint() override;
+    float rayHitTime(Ray ray, unsigned int primitive) override;
+    bool rayOccluded(Ray ray, unsigned int primitive, float maxTime) override;
+
+    auto inline getMesh() const -> const std::shared_ptr<TriangleMesh> &
+    {
+        return m_Mesh;
+    }
+
+  private:
+    auto toObjectSpace(const Ray &ray) const -> Ray;
+
+    std::shared_ptr<TriangleMesh> m_Mesh;
+    std::shared_ptr<const BVH> m_BVH{};
+    Transform m_ObjectToWorld;
+    Transform m_WorldToObject;
+};
@@ -1,13 +1,45 @@
 #include "Scene.h"
 
-#include <fstream>
 #include <iostream>
 #include <nlohmann/json.hpp>
+#include <stdexcept>
 using json = nlohmann::json;
 
 #include "Scene/Light.h"
+#include "Scene/MeshInstance.h"
+#include "Scene/SceneCache.h"
 #include "Scene/SceneObject.h"
+#include "Utils/MappedFile.h"
 #include "Utils/ObjModel.h"
+#include "Utils/Transform.h"
+
+/**
+ * reads the transform a model is placed with, the model is scaled, rotated about the x, y and z axes in that order
+ * and then translated
+ *
+ * \param transform - an object with an optional translate and rotate in degrees and a scale that is one number or
+ * one per axis
+ * \return - the transform from the space of the model into the scene
+ */
+static auto parseTransform(const json &transform) -> Transform
+{
+    Vec3 scale(1.0f);
+    if (transform.contains("scale"))
+    {
+        const json &scaleData = transform.at("scale");
+        scale = scaleData.is_number() ? Vec3(scaleData.get<float>()) : Vec3(scaleData.get<std::vector<float>>());
+    }
+    if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f)
+    {
+        throw std::invalid_argument("A model can not be scaled by 0!");
+    }
+
+    Vec3 rotate(transform.value("rotate", std::vector<float>{0.0f, 0.0f, 0.0f}));
+    Vec3 translate(transform.value("translate", std::vector<float>{0.0f, 0.0f, 0.0f}));
+
+    return Transform::translation(translate) * Transform::rotation(2, rotate.z) * Transform::rotation(1, rotate.y) *
+           Transform::rotation(0, rotate.x) * Transform::scaling(scale);
+}
 
 /**
  * returns the list of scene object that are present in the scene
@@ -28,7 +60,7 @@ auto Scene::getObjectList() -> std::vector<std::shared_ptr<SceneObject>>
  */
 void Scene::addObject(std::shared_ptr<SceneObject> sceneObject, std::string materialName)
 {
-    sceneObject->setMaterialName(materialName);
+    sceneObject->setMaterialId(getMaterialId(materialName));
     m_ObjectList.push_back(sceneObject);
 }
 
@@ -68,57 +100,164 @@ void Scene::addLight(std::shared_ptr<Light> light)
 }
 
 /**
- * adds a material to the scene's material store to be used and reused
- * in the scene
+ * adds a material to the scene's material table to be used and reused
+ * in the scene, a material registered under a name that is already taken replaces the old one
  *
- * \param material - the pointer to the material to be registered
+ * \param material - the material to be registered
+ * \return - the index of the material in the table
  */
-void Scene::registerMaterial(Material material)
+auto Scene::registerMaterial(Material material) -> unsigned int
 {
-    m_MaterialStore[material.name] = std::make_shared<Material>(material);
+    auto it = m_MaterialIds.find(material.name);
+    if (it != m_MaterialIds.end())
+    {
+        m_Materials[it->second] = std::move(material);
+        return it->second;
+    }
+
+    auto materialId = static_cast<unsigned int>(m_Materials.size());
+    m_MaterialIds[material.name] = materialId;
+    m_Materials.push_back(std::move(material));
+    return materialId;
 }
 
 /**
- * returns an already registered material in the scene's material store
+ * returns the index of an already registered material in the scene's material table
  *
  * \param materialName - the name of the desired material
- * \return - a pointer to the desired material
+ * \return - the index to look the material up with getMaterial
  */
-auto Scene::getMaterial(std::string materialName) -> std::shared_ptr<Material>
+auto Scene::getMaterialId(const std::string &materialName) -> unsigned int
 {
-    auto it = m_MaterialStore.find(materialName);
+    auto it = m_MaterialIds.find(materialName);
 
-    if (it == m_MaterialStore.end())
+    if (it == m_MaterialIds.end())
     {
         std::cout << "Material Not Found!" << std::endl;
         exit(EXIT_FAILURE);
     }
     else
     {
-        return m_MaterialStore.at(materialName);
+        return it->second;
     }
 }
 
 /**
  * creates a bounding volume heirarchy to accelerate ray scene intersections
+ *
+ * every model that is placed with a transform gets a bottom level BVH over its triangles that all its placements
+ * share, the top level BVH is built over the placements and the objects of the scene
+ *
+ * with the scene cache enabled BVHs built with the same settings are mapped from the cache, otherwise the BVHs are
+ * built and the cache is written
+ *
+ * \param settings - the builder, leaf size and surface area heuristic costs of the BVH, a model that picks its own
+ * builder gets a BVH built with that one
+ * \param threadPool - the pool that builds the BVH in parallel, null builds it on the calling thread
  */
-void Scene::createAcceleratedStructure()
+void Scene::createAcceleratedStructure(const BVHBuildSettings &settings, ThreadPool *threadPool)
 {
     if (m_ObjectList.size() <= 0)
     {
         std::cout << "Scene has no objects in it!" << std::endl;
+        return;
     }
-    else
+
+    uint64_t bvhKey = SceneCache::hashSettings(settings);
+
+    m_ModelBVHs.assign(m_ModelMeshes.size(), nullptr);
+    for (const ModelInstance &modelInstance : m_ModelInstances)
+    {
+        std::shared_ptr<BVH> &meshBVH = m_ModelBVHs[modelInstance.model];
+        if (!meshBVH)
+        {
+            BVHBuildSettings meshSettings = settings;
+            auto builder = m_ModelBuilders.find(modelInstance.model);
+            if (builder != m_ModelBuilders.end())
+            {
+                meshSettings.builder = builder->second;
+            }
+
+            // the builders models pick are part of the scene file, so the cache key already covers them
+            std::vector<std::shared_ptr<SceneObject>> meshObjects = {m_ModelMeshes[modelInstance.model]};
+            if (m_Cache && m_Cache->hasMeshBVH(modelInstance.model, bvhKey))
+            {
+                meshBVH =
+                    std::make_shared<BVH>(meshObjects, m_Cache->getMeshBVHData(modelInstance.model), meshSettings);
+            }
+            else
+            {
+                meshBVH = std::make_shared<BVH>(meshObjects, meshSettings, threadPool);
+            }
+        }
+        modelInstance.instance->setBVH(meshBVH);
+    }
+
+    if (m_Cache && m_Cache->hasBVH(bvhKey))
+    {
+        m_AcceleratedStructure = std::make_shared<BVH>(m_ObjectList, m_Cache->getBVHData(), settings);
+        return;
+    }
+
+    m_AcceleratedStructure = std::make_shared<BVH>(m_ObjectList, settings, threadPool);
+    if (!m_CachePath.empty())
+    {
+        SceneCache::write(m_CachePath, m_SceneKey, bvhKey, m_ModelMeshes, m_ModelBVHs, *m_AcceleratedStructure);
+    }
+}
+
+void Scene::setInstanceTransform(size_t instance, const Transform &transform)
+{
+    m_ModelInstances.at(instance).instance->setTransform(transform);
+    m_SceneMoved = true;
+}
+
+void Scene::setModelPositions(size_t model, std::vector<Vec3> positions)
+{
+    m_ModelMeshes.at(model)->setPositions(std::move(positions));
+    m_ModelsMoved[model] = true;
+    m_SceneMoved = true;
+}
+
+/**
+ * refits the BVHs of the models that were deformed, then the BVH over the scene
+ *
+ * moving instances only touches the BVH over the scene, the BVHs of their models stay as they are, so a rigid
+ * animation refits or rebuilds a tree with one primitive per instance
+ */
+void Scene::updateAcceleratedStructure(ThreadPool *threadPool)
+{
+    if (!m_AcceleratedStructure || !m_SceneMoved)
     {
-        m_AcceleratedStructure = std::make_shared<BVH>(m_ObjectList);
+        return;
     }
+
+    for (size_t model = 0; model < m_ModelMeshes.size(); model++)
+    {
+        if (m_ModelsMoved[model] && m_ModelBVHs[model])
+        {
+            m_ModelBVHs[model]->update(threadPool);
+        }
+    }
+
+    for (const ModelInstance &modelInstance : m_ModelInstances)
+    {
+        if (m_ModelsMoved[modelInstance.model])
+        {
+            modelInstance.instance->updateBounds();
+        }
+    }
+
+    m_AcceleratedStructure->update(threadPool);
+
+    m_ModelsMoved.assign(m_ModelMeshes.size(), false);
+    m_SceneMoved = false;
 }
 
-Scene::Scene(std::string filePath)
+Scene::Scene(std::string filePath, ThreadPool *threadPool, bool useCache)
 {
-    std::ifstream f(filePath);
-    json data = json::parse(f);
-    f.close();
+    MappedFile sceneFile(filePath);
+    json data = json::parse(sceneFile.getData(), sceneFile.getData() + sceneFile.getSize());
 
     m_AmbientLighting = Vec3(data.at(m_keywords.ambientLighting).get<std::vector<float>>());
     m_Camera = Camera(Vec3(data.at(m_keywords.camera).at(m_keywords.cameraOrg).get<std::vector<float>>()),
@@ -144,15 +283,69 @@ Scene::Scene(std::string filePath)
     }
 
     std::vector<json> objectList = data.at(m_keywords.objects);
+
+    // a model placed more than once is loaded once
+    std::vector<std::string> modelPaths;
+    std::unordered_map<std::string, size_t> modelIndices;
+    for (const json &object : objectList)
+    {
+        if (object.at("type") == "objModel")
+        {
+            std::string path = object.at("path");
+            if (modelIndices.emplace(path, modelPaths.size()).second)
+            {
+                modelPaths.push_back(path);
+            }
+        }
+    }
+
+    if (useCache)
+    {
+        // the scene file and every model it references make up the key, so editing any of them rewrites the cache
+        m_CachePath = filePath + ".ptcache";
+        m_SceneKey = SceneCache::hashBytes(sceneFile.getData(), sceneFile.getSize(), SceneCache::version);
+        for (const std::string &path : modelPaths)
+        {
+            MappedFile model(path);
+            m_SceneKey = SceneCache::hashBytes(model.getData(), model.getSize(), m_SceneKey);
+        }
+
+        m_Cache = SceneCache::load(m_CachePath, m_SceneKey, modelPaths.size());
+    }
+
+    for (size_t model = 0; model < modelPaths.size(); model++)
+    {
+        m_ModelMeshes.push_back(m_Cache ? m_Cache->getMesh(model) : ObjModel(modelPaths[model], threadPool).getMesh());
+    }
+    m_ModelsMoved.assign(m_ModelMeshes.size(), false);
+
+    // the first placement of a model without a transform adds its triangles to the top level BVH, every other
+    // placement is an instance that traces rays against the model's own BVH
+    std::vector<bool> modelAdded(modelPaths.size(), false);
     for (json object : objectList)
     {
         std::string type = object.at("type");
         std::string materialId = object.at("material");
         if (type == "objModel")
         {
-            std::string path = object.at("path");
-            ObjModel objModel(path);
-            addObjects(objModel.getSceneObjects(), materialId);
+            size_t model = modelIndices.at(object.at("path").get<std::string>());
+            if (object.contains("bvhBuilder"))
+            {
+                m_ModelBuilders.emplace(model, parseBVHBuilder(object.at("bvhBuilder").get<std::string>()));
+            }
+
+            if (!object.contains("transform") && !modelAdded[model])
+            {
+                modelAdded[model] = true;
+                addObject(m_ModelMeshes[model], materialId);
+            }
+            else
+            {
+                Transform transform = parseTransform(object.value("transform", json::object()));
+                auto instance = std::make_shared<MeshInstance>(m_ModelMeshes[model], transform);
+                m_ModelInstances.push_back({model, instance});
+                addObject(instance, materialId);
+            }
         }
         else if (type == "triangle")
         {
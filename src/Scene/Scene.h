@@ -7,6 +7,7 @@
 #include "BVH.h"
 #include "Light.h"
 #include "Material.h"
+#include "MeshInstance.h"
 #include "RayTracer/Camera.h"
 #include "SceneObject.h"
 
@@ -14,10 +15,20 @@
  * a collection of primitive scene objects, lights, and materials
  * that describe a scene for the ray tracer to render
  */
+class SceneCache;
+
 class Scene
 {
   public:
-    Scene(std::string filePath);
+    /**
+     * loads a scene file
+     *
+     * \param filePath - the path to the scene json file
+     * \param threadPool - the threads models are parsed on, the calling thread parses them alone if null
+     * \param useCache - map the models and BVH from a cache file next to the scene file, the cache is written once
+     * the BVH is built if it is missing or out of date
+     */
+    Scene(std::string filePath, ThreadPool *threadPool = nullptr, bool useCache = false);
 
   private:
     struct Keywords
@@ -37,11 +48,41 @@ class Scene
 
     std::vector<std::shared_ptr<SceneObject>> m_ObjectList{};
     std::vector<std::shared_ptr<Light>> m_LightList{};
-    std::unordered_map<std::string, std::shared_ptr<Material>> m_MaterialStore{};
+    // materials are looked up by name only while the scene loads, hits refer to them by their index in the table
+    std::vector<Material> m_Materials{};
+    std::unordered_map<std::string, unsigned int> m_MaterialIds{};
 
     std::shared_ptr<BVH> m_AcceleratedStructure{};
     Camera m_Camera;
 
+    /**
+     * a placement of a model with a transform, it traces rays against the BVH of the model's mesh
+     */
+    struct ModelInstance
+    {
+        size_t model;
+        std::shared_ptr<MeshInstance> instance;
+    };
+
+    // the meshes of the distinct models in the order they first appear in the scene file, a model placed more than
+    // once is loaded once, they are written to the scene cache
+    std::vector<std::shared_ptr<TriangleMesh>> m_ModelMeshes{};
+    std::vector<ModelInstance> m_ModelInstances{};
+
+    // the BVH over the triangles of each model, null for models that are not placed with a transform
+    std::vector<std::shared_ptr<BVH>> m_ModelBVHs{};
+
+    // the builder the first placement of a model that names one picked for the model's BVH, the others use the
+    // builder of the scene's BVH
+    std::unordered_map<size_t, BVHBuilder> m_ModelBuilders{};
+
+    // what moved since the acceleration structure was last updated
+    std::vector<bool> m_ModelsMoved{};
+    bool m_SceneMoved = false;
+    std::string m_CachePath{};
+    uint64_t m_SceneKey = 0;
+    std::shared_ptr<SceneCache> m_Cache{};
+
   public:
     std::vector<std::shared_ptr<SceneObject>> getObjectList();
     void addObject(std::shared_ptr<SceneObject> sceneObject, std::string materialName);
@@ -50,8 +91,18 @@ class Scene
     std::vector<std::shared_ptr<Light>> getLightList();
     void addLight(std::shared_ptr<Light> light);
 
-    void registerMaterial(Material material);
-    auto getMaterial(std::string materialName) -> std::shared_ptr<Material>;
+    auto registerMaterial(Material material) -> unsigned int;
+    auto getMaterialId(const std::string &materialName) -> unsigned int;
+
+    auto inline getMaterial(unsigned int materialId) const -> const Material &
+    {
+        return m_Materials[materialId];
+    }
+
+    auto inline getMaterials() const -> const std::vector<Material> &
+    {
+        return m_Materials;
+    }
 
     static Scene loadFromJson(std::string filePath);
 
@@ -70,7 +121,42 @@ class Scene
         return m_Camera;
     }
 
-    void createAcceleratedStructure();
+    void createAcceleratedStructure(const BVHBuildSettings &settings = {}, ThreadPool *threadPool = nullptr);
+
+    /**
+     * the number of models placed with a transform
+     */
+    auto inline getNumInstances() const -> size_t
+    {
+        return m_ModelInstances.size();
+    }
+
+    /**
+     * moves a model placed with a transform, the acceleration structure is out of date until it is updated
+     *
+     * \param instance - the index of the placement among the models placed with a transform, in the order of the
+     * scene file
+     * \param transform - the transform from the space of the model into the scene
+     */
+    void setInstanceTransform(size_t instance, const Transform &transform);
+
+    /**
+     * moves the vertices of a model and every placement of it with them, the acceleration structure is out of date
+     * until it is updated
+     *
+     * \param model - the index of the model among the distinct models, in the order they first appear in the scene
+     * file
+     * \param positions - the new position of every vertex of the model
+     */
+    void setModelPositions(size_t model, std::vector<Vec3> positions);
+
+    /**
+     * refits the BVHs of what moved since the last update, a refit BVH whose surface area heuristic cost grew past
+     * the rebuild cost ratio of the build settings is rebuilt, must not be called while the scene is rendered
+     *
+     * \param threadPool - the pool that refits and rebuilds the BVHs, null works on the calling thread
+     */
+    void updateAcceleratedStructure(ThreadPool *threadPool = nullptr);
     std::shared_ptr<BVH> getAccelerationStructure()
     {
         return m_AcceleratedStructure;
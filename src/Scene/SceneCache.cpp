@@ -0,0 +1,321 @@
+#include "SceneCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static constexpr char cacheMagic[8] = {'P', 'T', 'S', 'C', 'A', 'C', 'H', 'E'};
+
+static auto rotateLeft(uint64_t value, int bits) -> uint64_t
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * the next multiple of alignment at or above offset
+ */
+static auto alignOffset(uint64_t offset, uint64_t alignment) -> uint64_t
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+SceneCache::SceneCache(std::shared_ptr<const MappedFile> file) : m_File(std::move(file))
+{
+    m_Header = reinterpret_cast<const Header *>(m_File->getData());
+    m_Meshes = reinterpret_cast<const MeshEntry *>(m_File->getData() + sizeof(Header));
+}
+
+template <typename T> auto SceneCache::isValid(const Section &section) const -> bool
+{
+    uint64_t size = m_File->getSize();
+    return section.offset % cacheAlignment == 0 && section.offset <= size &&
+           section.count <= (size - section.offset) / sizeof(T);
+}
+
+template <typename T> auto SceneCache::view(const Section &section) const -> DataBuffer<T>
+{
+    return DataBuffer<T>(m_File, static_cast<size_t>(section.offset), static_cast<size_t>(section.count));
+}
+
+auto SceneCache::isValid(const BVHSections &bvh) const -> bool
+{
+    bool valid = isValid<LinearBVHNode>(bvh.nodes) && isValid<PrimitiveRef>(bvh.primitives);
+    if (bvh.wideWidth == 8)
+    {
+        return valid && isValid<WideBVHNode<8>>(bvh.wideNodes);
+    }
+    return valid && isValid<WideBVHNode<4>>(bvh.wideNodes);
+}
+
+auto SceneCache::viewBVH(const BVHSections &bvh) const -> BVHData
+{
+    BVHData data;
+    data.nodes = view<LinearBVHNode>(bvh.nodes);
+    data.primitives = view<PrimitiveRef>(bvh.primitives);
+    if (bvh.wideWidth == 8)
+    {
+        data.wideNodes8 = view<WideBVHNode<8>>(bvh.wideNodes);
+    }
+    else if (bvh.wideWidth == 4)
+    {
+        data.wideNodes4 = view<WideBVHNode<4>>(bvh.wideNodes);
+    }
+    return data;
+}
+
+auto SceneCache::load(const std::string &filePath, uint64_t sceneKey, size_t numMeshes) -> std::shared_ptr<SceneCache>
+{
+    std::shared_ptr<const MappedFile> file;
+    try
+    {
+        file = std::make_shared<const MappedFile>(filePath);
+    }
+    catch (const std::runtime_error &)
+    {
+        std::cout << "No scene cache at " << filePath << " yet." << std::endl;
+        return nullptr;
+    }
+
+    if (file->getSize() < sizeof(Header) + numMeshes * sizeof(MeshEntry))
+    {
+        std::cout << "Scene cache " << filePath << " is out of date." << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<SceneCache> cache(new SceneCache(file));
+    const Header &header = *cache->m_Header;
+    bool matches = std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 && header.version == version &&
+                   header.layout == layout() && header.fileSize == file->getSize() && header.sceneKey == sceneKey &&
+                   header.numMeshes == numMeshes;
+
+    // the sections are checked to lie inside the file, their contents are trusted
+    matches = matches && cache->isValid(header.bvh);
+    for (size_t i = 0; matches && i < numMeshes; i++)
+    {
+        const MeshEntry &mesh = cache->m_Meshes[i];
+        matches = cache->isValid<Vec3>(mesh.positions) && cache->isValid<Vec3>(mesh.normals) &&
+                  cache->isValid<uint32_t>(mesh.positionIndices) && cache->isValid<uint32_t>(mesh.normalIndices) &&
+                  mesh.positionIndices.count == mesh.normalIndices.count && cache->isValid(mesh.bvh);
+    }
+
+    if (!matches)
+    {
+        std::cout << "Scene cache " << filePath << " is out of date." << std::endl;
+        return nullptr;
+    }
+
+    std::cout << "Mapped " << numMeshes << " models from the scene cache " << filePath << "." << std::endl;
+    return cache;
+}
+
+auto SceneCache::write(const std::string &filePath, uint64_t sceneKey, uint64_t bvhKey,
+                       const std::vector<std::shared_ptr<TriangleMesh>> &meshes,
+                       const std::vector<std::shared_ptr<BVH>> &meshBVHs, const BVH &bvh) -> bool
+{
+    // every array gets the next aligned offset after the one before it
+    uint64_t offset = alignOffset(sizeof(Header) + meshes.size() * sizeof(MeshEntry), cacheAlignment);
+    auto place = [&offset](size_t count, size_t elementSize) {
+        Section section{offset, count};
+        offset = alignOffset(offset + count * elementSize, cacheAlignment);
+        return section;
+    };
+
+    // the collapsed tree is stored as well, collapsing takes longer than mapping the rest of the cache
+    auto placeBVH = [&place](const BVH *tree) {
+        BVHSections sections{};
+        sections.nodes = place(tree ? tree->getNodes().size() : 0, sizeof(LinearBVHNode));
+        sections.primitives = place(tree ? tree->getPrimitives().size() : 0, sizeof(PrimitiveRef));
+        if (tree && tree->getWideBVH8())
+        {
+            sections.wideWidth = 8;
+            sections.wideNodes = place(tree->getWideBVH8()->getNodes().size(), sizeof(WideBVHNode<8>));
+        }
+        else if (tree && tree->getWideBVH4())
+        {
+            sections.wideWidth = 4;
+            sections.wideNodes = place(tree->getWideBVH4()->getNodes().size(), sizeof(WideBVHNode<4>));
+        }
+        else
+        {
+            sections.wideNodes = place(0, 1);
+        }
+        return sections;
+    };
+
+    std::vector<MeshEntry> entries(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        entries[i].positions = place(meshes[i]->getPositions().size(), sizeof(Vec3));
+        entries[i].normals = place(meshes[i]->getNormals().size(), sizeof(Vec3));
+        entries[i].positionIndices = place(meshes[i]->getPositionIndices().size(), sizeof(uint32_t));
+        entries[i].normalIndices = place(meshes[i]->getNormalIndices().size(), sizeof(uint32_t));
+        entries[i].bvh = placeBVH(meshBVHs[i].get());
+    }
+
+    Header header{};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = version;
+    header.layout = layout();
+    header.sceneKey = sceneKey;
+    header.bvhKey = bvhKey;
+    header.numMeshes = meshes.size();
+    header.bvh = placeBVH(&bvh);
+    header.fileSize = offset;
+
+    std::string tempPath = filePath + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+
+    // the arrays are written in the order they were placed, the gaps before them are zero padding
+    uint64_t written = 0;
+    auto writeBytes = [&file, &written](const void *data, uint64_t at, size_t size) {
+        static const char padding[cacheAlignment] = {};
+        file.write(padding, static_cast<std::streamsize>(at - written));
+        file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        written = at + size;
+    };
+
+    auto writeBVH = [&writeBytes](const BVH &tree, const BVHSections &sections) {
+        writeBytes(tree.getNodes().data(), sections.nodes.offset, tree.getNodes().size() * sizeof(LinearBVHNode));
+        writeBytes(tree.getPrimitives().data(), sections.primitives.offset,
+                   tree.getPrimitives().size() * sizeof(PrimitiveRef));
+        if (tree.getWideBVH8())
+        {
+            writeBytes(tree.getWideBVH8()->getNodes().data(), sections.wideNodes.offset,
+                       tree.getWideBVH8()->getNodes().size() * sizeof(WideBVHNode<8>));
+        }
+        else if (tree.getWideBVH4())
+        {
+            writeBytes(tree.getWideBVH4()->getNodes().data(), sections.wideNodes.offset,
+                       tree.getWideBVH4()->getNodes().size() * sizeof(WideBVHNode<4>));
+        }
+    };
+
+    writeBytes(&header, 0, sizeof(Header));
+    writeBytes(entries.data(), sizeof(Header), entries.size() * sizeof(MeshEntry));
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const TriangleMesh &mesh = *meshes[i];
+        writeBytes(mesh.getPositions().data(), entries[i].positions.offset, mesh.getPositions().size() * sizeof(Vec3));
+        writeBytes(mesh.getNormals().data(), entries[i].normals.offset, mesh.getNormals().size() * sizeof(Vec3));
+        writeBytes(mesh.getPositionIndices().data(), entries[i].positionIndices.offset,
+                   mesh.getPositionIndices().size() * sizeof(uint32_t));
+        writeBytes(mesh.getNormalIndices().data(), entries[i].normalIndices.offset,
+                   mesh.getNormalIndices().size() * sizeof(uint32_t));
+        if (meshBVHs[i])
+        {
+            writeBVH(*meshBVHs[i], entries[i].bvh);
+        }
+    }
+    writeBVH(bvh, header.bvh);
+    writeBytes(nullptr, header.fileSize, 0);
+    file.close();
+
+    // renaming over a mapped file fails on windows, the old cache is then removed first
+    bool renamed = file && std::rename(tempPath.c_str(), filePath.c_str()) == 0;
+    if (file && !renamed)
+    {
+        renamed = std::remove(filePath.c_str()) == 0 && std::rename(tempPath.c_str(), filePath.c_str()) == 0;
+    }
+    if (!renamed)
+    {
+        std::remove(tempPath.c_str());
+        std::cerr << "Could not write the scene cache " << filePath << "!" << std::endl;
+        return false;
+    }
+
+    double megabytes = static_cast<double>(header.fileSize) / (1024.0 * 1024.0);
+    std::cout << "Wrote the scene cache " << filePath << " (" << megabytes << " MB)." << std::endl;
+    return true;
+}
+
+/**
+ * four lanes of 64 bit words are mixed with multiplies and rotations so the multiplies of neighbouring words
+ * overlap, the lanes and the bytes left over are then folded together and the result is avalanched
+ */
+auto SceneCache::hashBytes(const void *data, size_t size, uint64_t seed) -> uint64_t
+{
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int lane = 0; lane < 4; lane++)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i + 8 * lane, sizeof(word));
+            lanes[lane] = rotateLeft(lanes[lane] + word * prime2, 31) * prime1;
+        }
+    }
+
+    uint64_t hash = seed + static_cast<uint64_t>(size) * prime1;
+    for (uint64_t lane : lanes)
+    {
+        hash = rotateLeft(hash ^ (rotateLeft(lane * prime2, 31) * prime1), 27) * prime1 + prime2;
+    }
+
+    for (; i < size; i++)
+    {
+        hash = rotateLeft(hash ^ (bytes[i] * prime1), 11) * prime2;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+auto SceneCache::hashSettings(const BVHBuildSettings &settings) -> uint64_t
+{
+    // the width only changes how the binary tree is collapsed when it is loaded
+    uint32_t values[5] = {static_cast<uint32_t>(settings.builder), settings.maxObjectsInLeaf, settings.numBins, 0, 0};
+    std::memcpy(&values[3], &settings.traversalCost, sizeof(float));
+    std::memcpy(&values[4], &settings.intersectionCost, sizeof(float));
+    return hashBytes(values, sizeof(values), version);
+}
+
+auto SceneCache::getMesh(size_t index) const -> std::shared_ptr<TriangleMesh>
+{
+    const MeshEntry &mesh = m_Meshes[index];
+    return std::make_shared<TriangleMesh>(view<Vec3>(mesh.positions), view<Vec3>(mesh.normals),
+                                          view<uint32_t>(mesh.positionIndices), view<uint32_t>(mesh.normalIndices));
+}
+
+auto SceneCache::hasBVH(uint64_t bvhKey) const -> bool
+{
+    return m_Header->bvhKey == bvhKey && m_Header->bvh.nodes.count > 0;
+}
+
+auto SceneCache::getBVHData() const -> BVHData
+{
+    return viewBVH(m_Header->bvh);
+}
+
+auto SceneCache::hasMeshBVH(size_t index, uint64_t bvhKey) const -> bool
+{
+    return m_Header->bvhKey == bvhKey && m_Meshes[index].bvh.nodes.count > 0;
+}
+
+auto SceneCache::getMeshBVHData(size_t index) const -> BVHData
+{
+    return viewBVH(m_Meshes[index].bvh);
+}
+
+/**
+ * the sizes of the types stored in the file and the byte order of the machine, packed into one word
+ */
+auto SceneCache::layout() -> uint32_t
+{
+    const uint16_t byteOrder = 1;
+    uint8_t littleEndian;
+    std::memcpy(&littleEndian, &byteOrder, 1);
+
+    return static_cast<uint32_t>(sizeof(Vec3)) | static_cast<uint32_t>(sizeof(LinearBVHNode)) << 8 |
+           static_cast<uint32_t>(sizeof(PrimitiveRef)) << 16 | static_cast<uint32_t>(littleEndian) << 24;
+}
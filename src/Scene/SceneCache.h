@@ -0,0 +1,150 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "SceneObject.h"
+#include "WideBVH.h"
+#include "Utils/MappedFile.h"
+
+/**
+ * a binary file that holds the triangle meshes of a scene's models, the BVHs of the instanced meshes and the
+ * flattened BVH over the whole scene
+ *
+ * the cache is written after a scene was loaded and its BVH built, later launches map it read only and the meshes
+ * and BVH view the mapped file instead of parsing the models and building the tree again, so processes rendering
+ * the same scene share its pages in the page cache
+ *
+ * the file is keyed by a hash of the scene file and its models and by a hash of the BVH build settings, a cache
+ * written for other contents or by another version of the format is ignored
+ */
+class SceneCache
+{
+  public:
+    /**
+     * raised whenever the layout of the file changes
+     */
+    static constexpr uint32_t version = 2;
+
+    /**
+     * maps a cache file
+     *
+     * \param filePath - the path of the cache file
+     * \param sceneKey - the hash of the scene file and its models the cache has to be written for
+     * \param numMeshes - the number of distinct models of the scene
+     * \return - null if there is no cache or it does not match the scene
+     */
+    static auto load(const std::string &filePath, uint64_t sceneKey, size_t numMeshes) -> std::shared_ptr<SceneCache>;
+
+    /**
+     * writes a cache file, a temporary file is renamed over the old cache so readers never see a partial file
+     *
+     * \param meshes - the meshes of the distinct models of the scene in the order they first appear in the scene file
+     * \param meshBVHs - the BVH over the triangles of each mesh, null for meshes that are not instanced
+     * \param bvh - the BVH built over the scene
+     * \return - false if the file could not be written
+     */
+    static auto write(const std::string &filePath, uint64_t sceneKey, uint64_t bvhKey,
+                      const std::vector<std::shared_ptr<TriangleMesh>> &meshes,
+                      const std::vector<std::shared_ptr<BVH>> &meshBVHs, const BVH &bvh) -> bool;
+
+    /**
+     * a 64 bit hash of a block of memory, fast enough to hash models on every launch but not cryptographic
+     */
+    static auto hashBytes(const void *data, size_t size, uint64_t seed) -> uint64_t;
+
+    /**
+     * a hash of the build settings that change the binary tree
+     */
+    static auto hashSettings(const BVHBuildSettings &settings) -> uint64_t;
+
+    /**
+     * creates the mesh of the model at an index, its arrays view the mapped file
+     */
+    auto getMesh(size_t index) const -> std::shared_ptr<TriangleMesh>;
+
+    /**
+     * true if the cache holds a BVH built with the settings the key was hashed from
+     */
+    auto hasBVH(uint64_t bvhKey) const -> bool;
+
+    /**
+     * the arrays of the cached BVH, they view the mapped file
+     */
+    auto getBVHData() const -> BVHData;
+
+    /**
+     * true if the cache holds a BVH over the triangles of the mesh at an index built with the settings the key was
+     * hashed from
+     */
+    auto hasMeshBVH(size_t index, uint64_t bvhKey) const -> bool;
+
+    /**
+     * the arrays of the cached BVH of the mesh at an index, they view the mapped file
+     */
+    auto getMeshBVHData(size_t index) const -> BVHData;
+
+  private:
+    /**
+     * an array stored in the file, its byte offset is aligned to cacheAlignment
+     */
+    struct Section
+    {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    /**
+     * the arrays of a flattened BVH, a BVH that was not stored has no nodes
+     */
+    struct BVHSections
+    {
+        Section nodes;
+        Section primitives;
+
+        // the wide tree rays were traced with when the cache was written, 0 if the binary tree was traced
+        uint64_t wideWidth;
+        Section wideNodes;
+    };
+
+    struct MeshEntry
+    {
+        Section positions;
+        Section normals;
+        Section positionIndices;
+        Section normalIndices;
+        BVHSections bvh;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+
+        // the sizes of the stored types and a byte order mark, a cache written by another build is not read
+        uint32_t layout;
+
+        uint64_t fileSize;
+        uint64_t sceneKey;
+        uint64_t bvhKey;
+        uint64_t numMeshes;
+        BVHSections bvh;
+    };
+
+    static constexpr size_t cacheAlignment = 64;
+
+    SceneCache(std::shared_ptr<const MappedFile> file);
+
+    static auto layout() -> uint32_t;
+    template <typename T> auto isValid(const Section &section) const -> bool;
+    template <typename T> auto view(const Section &section) const -> DataBuffer<T>;
+    auto isValid(const BVHSections &bvh) const -> bool;
+    auto viewBVH(const BVHSections &bvh) const -> BVHData;
+
+    std::shared_ptr<const MappedFile> m_File;
+    const Header *m_Header;
+    const MeshEntry *m_Meshes;
+};
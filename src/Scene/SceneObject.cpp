@@ -1,21 +1,21 @@
 #include "SceneObject.h"
 
+#include <algorithm>
 #include <cmath>
-
-#include <cmath>
+#include <stdexcept>
 
 #define EPSILON 0.0000001f
 
 // SCENE OBJECT
 
 /**
- * sets the name of the material that describes the surface of the scene object
+ * sets the material that describes the surface of the scene object
  *
- * \param name - name of the material as a string
+ * \param materialId - the index of the material in the scene's material table
  */
-void SceneObject::setMaterialName(std::string &name)
+void SceneObject::setMaterialId(unsigned int materialId)
 {
-    m_MaterialName = name;
+    m_MaterialId = materialId;
 }
 
 // TRIANGLE
@@ -65,77 +65,20 @@ Triangle::Triangle(Vec3 p0, Vec3 n0, Vec3 p1, Vec3 n1, Vec3 p2, Vec3 n2)
 }
 
 /**
- * calculate the area of the triangle defined by points p0, p1, and p2.
- *
- * \param p0 - the position of the first point of the triangle
- * \param p1 - the position of the second point of the triangle
- * \param p2 - the position of the thrid point of the triangle
- *
- */
-float triangleArea(Vec3 p0, Vec3 p1, Vec3 p2)
-{
-    Vec3 v02 = p2 - p0;
-    Vec3 v12 = p2 - p1;
-
-    return v02.cross(v12).length() / 2.0f;
-}
-
-/**
- * calculates the normal of the surface of the triangle
- *
- * \param position - the position on the triangle to calculate the normal of
- * \return - the normalmalized normal vector
- */
-Vec3 Triangle::getNormal(Vec3 position)
-{
-    if (!hasNormalVertices)
-    {
-        Vec3 v1 = point1 - point0;
-        Vec3 v2 = point2 - point0;
-
-        Vec3 normal = v1.cross(v2);
-        normal.normalize();
-
-        return normal;
-    }
-    else
-    {
-        float areaTotal = triangleArea(point0, point1, point2);
-        float area0 = triangleArea(position, point1, point2);
-        float area1 = triangleArea(position, point2, point0);
-        float area2 = triangleArea(position, point0, point1);
-
-        float weight0 = area0 / areaTotal;
-        float weight1 = area1 / areaTotal;
-        float weight2 = area2 / areaTotal;
-
-        Vec3 interpolatedNormal = (normal0 * weight0) + (normal1 * weight1) + (normal2 * weight2);
-        interpolatedNormal.normalize();
-
-        return interpolatedNormal;
-    }
-}
-
-/**
- * calculates if a ray intersects the triangle
+ * calculates the time a ray hits a triangle
  * adapted from Moller-Trumbore intersection algorithm pseudocode on wikipedia
  * https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
  *
+ * \param v0, v1, v2 - the corners of the triangle
  * \param ray - the ray that possibly interescts the triangle
- * \return - the hit object that tells if the ray interesects the triangle
- *			 along with other relevant information
+ * \param hitU, hitV - set to the barycentric coordinates of the intersection, the weights of v1 and v2
+ * \return - the time of the intersection, INFINITY if the ray misses the triangle
  */
-auto Triangle::rayIntersect(Ray ray) -> Hit
+static auto triangleHitTime(Vec3 v0, Vec3 v1, Vec3 v2, Ray ray, float &hitU, float &hitV) -> float
 {
-    Hit hit;
-
     Vec3 orig = ray.org;
     Vec3 dir = ray.dir;
 
-    Vec3 v0 = point0;
-    Vec3 v1 = point1;
-    Vec3 v2 = point2;
-
     // vectors for edges sharing V1
     Vec3 e1 = v1 - v0;
     Vec3 e2 = v2 - v0;
@@ -148,7 +91,7 @@ auto Triangle::rayIntersect(Ray ray) -> Hit
     // NOT culling
     if (det > -EPSILON && det < EPSILON)
     {
-        return hit;
+        return INFINITY;
     }
     float invDet = 1.0f / det;
 
@@ -160,7 +103,7 @@ auto Triangle::rayIntersect(Ray ray) -> Hit
     // the intersection lies outside of the triangle
     if (u < 0.0f || u > 1.0f)
     {
-        return hit;
+        return INFINITY;
     }
     // prepare to test v parameter
     Vec3 q = dist.cross(e1);
@@ -171,25 +114,111 @@ auto Triangle::rayIntersect(Ray ray) -> Hit
     // the intersection is outside the triangle
     if (v < 0.0 || (u + v) > 1.0f)
     {
-        return hit;
+        return INFINITY;
     }
 
     float t = e2.dot(q) * invDet;
 
     if (t > 0.0)
     {
-        hit.isHit = true;
-        hit.materialName = m_MaterialName;
-        hit.time = t;
-        hit.position = ray.posAt(t);
-        hit.normal = getNormal(hit.position);
+        hitU = u;
+        hitV = v;
+        return t;
+    }
+
+    return INFINITY;
+}
+
+/**
+ * calculates the normal of the plane of a triangle
+ */
+static auto flatTriangleNormal(Vec3 p0, Vec3 p1, Vec3 p2) -> Vec3
+{
+    Vec3 v1 = p1 - p0;
+    Vec3 v2 = p2 - p0;
+
+    Vec3 normal = v1.cross(v2);
+    normal.normalize();
+
+    return normal;
+}
+
+/**
+ * interpolates the normals at the corners of a triangle by the barycentric coordinates of a hit
+ */
+static auto interpolatedTriangleNormal(float u, float v, Vec3 n0, Vec3 n1, Vec3 n2) -> Vec3
+{
+    Vec3 interpolatedNormal = (n0 * (1.0f - u - v)) + (n1 * u) + (n2 * v);
+    interpolatedNormal.normalize();
+
+    return interpolatedNormal;
+}
+
+/**
+ * records the hit of a ray with the triangle if it is closer than the closest hit so far
+ *
+ * \param ray - the ray that possibly interescts the triangle
+ * \param primitive - unused, a triangle is a single primitive
+ * \param closest - the closest hit so far
+ * \return - true if the triangle is the new closest hit
+ */
+auto Triangle::rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) -> bool
+{
+    float u = 0.0f;
+    float v = 0.0f;
+    float t = triangleHitTime(point0, point1, point2, ray, u, v);
+    if (t < closest.time)
+    {
+        closest.time = t;
+        closest.u = u;
+        closest.v = v;
+        return true;
+    }
 
-        return hit;
+    return false;
+}
+
+/**
+ * fills in the position, normal and material of a hit on the triangle
+ *
+ * \param ray - the ray that hit the triangle
+ * \param primitiveHit - the hit recorded by rayIntersect
+ * \return - the hit object with all relevant information
+ */
+auto Triangle::shadeHit(Ray ray, const PrimitiveHit &primitiveHit) -> Hit
+{
+    Hit hit;
+    hit.isHit = true;
+    hit.materialId = m_MaterialId;
+    hit.time = primitiveHit.time;
+    hit.position = ray.posAt(primitiveHit.time);
+
+    if (hasNormalVertices)
+    {
+        hit.normal = interpolatedTriangleNormal(primitiveHit.u, primitiveHit.v, normal0, normal1, normal2);
+    }
+    else
+    {
+        hit.normal = flatTriangleNormal(point0, point1, point2);
     }
 
     return hit;
 }
 
+/**
+ * calculates the time a ray hits the triangle
+ *
+ * \param ray - the ray that possibly interescts the triangle
+ * \param primitive - unused, a triangle is a single primitive
+ * \return - the time of the intersection, INFINITY if the ray misses the triangle
+ */
+auto Triangle::rayHitTime(Ray ray, unsigned int primitive) -> float
+{
+    float u = 0.0f;
+    float v = 0.0f;
+    return triangleHitTime(point0, point1, point2, ray, u, v);
+}
+
 /**
  * calculates the center point of the triangle by averaging all 3 points
  *
@@ -239,29 +268,66 @@ auto Sphere::getNormal(Vec3 position) -> Vec3
 }
 
 /**
- * calculates if a ray intersects a sphere
+ * records the hit of a ray with the sphere if it is closer than the closest hit so far
  *
  * \param ray - the ray to test for an intersection
- * \return - the hit object that tells if the ray interesects the sphere
- *			 along with other relevant information
+ * \param primitive - unused, a sphere is a single primitive
+ * \param closest - the closest hit so far
+ * \return - true if the sphere is the new closest hit
+ */
+auto Sphere::rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) -> bool
+{
+    float t = rayHitTime(ray, primitive);
+    if (t < closest.time)
+    {
+        closest.time = t;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * fills in the position, normal and material of a hit on the sphere
+ *
+ * \param ray - the ray that hit the sphere
+ * \param primitiveHit - the hit recorded by rayIntersect
+ * \return - the hit object with all relevant information
  */
-auto Sphere::rayIntersect(Ray ray) -> Hit
+auto Sphere::shadeHit(Ray ray, const PrimitiveHit &primitiveHit) -> Hit
 {
     Hit hit;
+    hit.isHit = true;
+    hit.materialId = m_MaterialId;
+    hit.time = primitiveHit.time;
+    hit.position = ray.posAt(primitiveHit.time);
+    hit.normal = getNormal(hit.position);
 
+    return hit;
+}
+
+/**
+ * calculates the time a ray hits a sphere
+ *
+ * \param ray - the ray to test for an intersection
+ * \param primitive - unused, a sphere is a single primitive
+ * \return - the time of the first intersection in front of the ray origin, INFINITY if the ray misses the sphere
+ */
+auto Sphere::rayHitTime(Ray ray, unsigned int primitive) -> float
+{
     Vec3 l = m_Center - ray.org;
 
     float tca = l.dot(ray.dir);
     if (tca < 0.0f)
     {
-        return hit;
+        return INFINITY;
     }
 
     float d2 = l.dot(l) - tca * tca;
     float radius2 = m_Radius * m_Radius;
     if (d2 > radius2)
     {
-        return hit;
+        return INFINITY;
     }
 
     float thc = sqrtf(radius2 - d2);
@@ -280,17 +346,11 @@ auto Sphere::rayIntersect(Ray ray) -> Hit
         // t0 and t1 are both negative
         if (t0 < 0.0f)
         {
-            return hit;
+            return INFINITY;
         }
     }
 
-    hit.isHit = true;
-    hit.materialName = m_MaterialName;
-    hit.time = t0;
-    hit.position = ray.posAt(t0);
-    hit.normal = getNormal(hit.position);
-
-    return hit;
+    return t0;
 }
 
 /**
@@ -302,3 +362,211 @@ auto Sphere::getCenterPoint() -> Vec3
 {
     return m_Center;
 }
+
+// TRIANGLE MESH
+
+/**
+ * creates an empty mesh over a set of vertices
+ *
+ * \param positions - the positions of the vertices the triangles are made of
+ * \param normals - the normals the corners of the triangles can refer to
+ */
+TriangleMesh::TriangleMesh(std::vector<Vec3> positions, std::vector<Vec3> normals)
+    : m_Positions(std::move(positions)), m_Normals(std::move(normals))
+{
+    minX = minY = minZ = INFINITY;
+    maxX = maxY = maxZ = -INFINITY;
+}
+
+TriangleMesh::TriangleMesh(DataBuffer<Vec3> positions, DataBuffer<Vec3> normals, DataBuffer<uint32_t> positionIndices,
+                           DataBuffer<uint32_t> normalIndices)
+    : m_Positions(std::move(positions)), m_Normals(std::move(normals)),
+      m_PositionIndices(std::move(positionIndices)), m_NormalIndices(std::move(normalIndices))
+{
+    computeBounds();
+}
+
+/**
+ * moves the vertices of the mesh, a BVH over the mesh has to be refit afterwards
+ *
+ * \param positions - the new position of every vertex, in the order of the old positions
+ */
+void TriangleMesh::setPositions(DataBuffer<Vec3> positions)
+{
+    if (positions.size() != m_Positions.size())
+    {
+        throw std::invalid_argument("A mesh has to keep its number of vertices when they are moved!");
+    }
+
+    m_Positions = std::move(positions);
+    computeBounds();
+}
+
+/**
+ * bounds the positions used by a triangle
+ */
+void TriangleMesh::computeBounds()
+{
+    minX = minY = minZ = INFINITY;
+    maxX = maxY = maxZ = -INFINITY;
+
+    for (uint32_t index : m_PositionIndices)
+    {
+        const Vec3 &position = m_Positions[index];
+        minX = std::min(minX, position.x);
+        minY = std::min(minY, position.y);
+        minZ = std::min(minZ, position.z);
+
+        maxX = std::max(maxX, position.x);
+        maxY = std::max(maxY, position.y);
+        maxZ = std::max(maxZ, position.z);
+    }
+}
+
+void TriangleMesh::addTriangle(uint32_t p0, uint32_t p1, uint32_t p2)
+{
+    addTriangle(p0, flatNormal, p1, flatNormal, p2, flatNormal);
+}
+
+void TriangleMesh::addTriangle(uint32_t p0, uint32_t n0, uint32_t p1, uint32_t n1, uint32_t p2, uint32_t n2)
+{
+    m_PositionIndices.append({p0, p1, p2});
+    m_NormalIndices.append({n0, n1, n2});
+
+    for (uint32_t index : {p0, p1, p2})
+    {
+        const Vec3 &position = m_Positions[index];
+        minX = std::min(minX, position.x);
+        minY = std::min(minY, position.y);
+        minZ = std::min(minZ, position.z);
+
+        maxX = std::max(maxX, position.x);
+        maxY = std::max(maxY, position.y);
+        maxZ = std::max(maxZ, position.z);
+    }
+}
+
+/**
+ * records the hit of a ray with a triangle of the mesh if it is closer than the closest hit so far
+ *
+ * \param ray - the ray that possibly interescts the triangle
+ * \param primitive - the index of the triangle
+ * \param closest - the closest hit so far
+ * \return - true if the triangle is the new closest hit
+ */
+auto TriangleMesh::rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) -> bool
+{
+    const uint32_t *positionIndices = &m_PositionIndices[3 * static_cast<size_t>(primitive)];
+
+    float u = 0.0f;
+    float v = 0.0f;
+    float t = triangleHitTime(m_Positions[positionIndices[0]], m_Positions[positionIndices[1]],
+                              m_Positions[positionIndices[2]], ray, u, v);
+    if (t < closest.time)
+    {
+        closest.time = t;
+        closest.u = u;
+        closest.v = v;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * fills in the position, normal and material of a hit on a triangle of the mesh
+ *
+ * \param ray - the ray that hit the triangle
+ * \param primitiveHit - the hit recorded by rayIntersect
+ * \return - the hit object with all relevant information
+ */
+auto TriangleMesh::shadeHit(Ray ray, const PrimitiveHit &primitiveHit) -> Hit
+{
+    const uint32_t *positionIndices = &m_PositionIndices[3 * static_cast<size_t>(primitiveHit.primitive)];
+    const uint32_t *normalIndices = &m_NormalIndices[3 * static_cast<size_t>(primitiveHit.primitive)];
+
+    Hit hit;
+    hit.isHit = true;
+    hit.materialId = m_MaterialId;
+    hit.time = primitiveHit.time;
+    hit.position = ray.posAt(primitiveHit.time);
+
+    if (normalIndices[0] == flatNormal)
+    {
+        hit.normal = flatTriangleNormal(m_Positions[positionIndices[0]], m_Positions[positionIndices[1]],
+                                        m_Positions[positionIndices[2]]);
+    }
+    else
+    {
+        hit.normal = interpolatedTriangleNormal(primitiveHit.u, primitiveHit.v, m_Normals[normalIndices[0]],
+                                                m_Normals[normalIndices[1]], m_Normals[normalIndices[2]]);
+    }
+
+    return hit;
+}
+
+/**
+ * calculates the time a ray hits a triangle of the mesh
+ *
+ * \param ray - the ray that possibly interescts the triangle
+ * \param primitive - the index of the triangle
+ * \return - the time of the intersection, INFINITY if the ray misses the triangle
+ */
+auto TriangleMesh::rayHitTime(Ray ray, unsigned int primitive) -> float
+{
+    const uint32_t *positionIndices = &m_PositionIndices[3 * static_cast<size_t>(primitive)];
+
+    float u = 0.0f;
+    float v = 0.0f;
+    return triangleHitTime(m_Positions[positionIndices[0]], m_Positions[positionIndices[1]],
+                           m_Positions[positionIndices[2]], ray, u, v);
+}
+
+/**
+ * checks if a triangle of the mesh blocks a ray at or before maxTime, without a second virtual call per triangle
+ */
+auto TriangleMesh::rayOccluded(Ray ray, unsigned int primitive, float maxTime) -> bool
+{
+    return TriangleMesh::rayHitTime(ray, primitive) <= maxTime;
+}
+
+/**
+ * calculates the center of the mesh's bounds
+ *
+ * \return - the center point as a Vec3
+ */
+auto TriangleMesh::getCenterPoint() -> Vec3
+{
+    return Vec3((minX + maxX) / 2.0f, (minY + maxY) / 2.0f, (minZ + maxZ) / 2.0f);
+}
+
+auto TriangleMesh::getNumPrimitives() -> unsigned int
+{
+    return static_cast<unsigned int>(m_PositionIndices.size() / 3);
+}
+
+/**
+ * calculates the center point of a triangle of the mesh by averaging all 3 points
+ */
+auto TriangleMesh::getPrimitiveCenter(unsigned int primitive) -> Vec3
+{
+    const uint32_t *positionIndices = &m_PositionIndices[3 * static_cast<size_t>(primitive)];
+    Vec3 p0 = m_Positions[positionIndices[0]];
+    Vec3 p1 = m_Positions[positionIndices[1]];
+    Vec3 p2 = m_Positions[positionIndices[2]];
+
+    return (p0 + p1 + p2) / 3.0f;
+}
+
+void TriangleMesh::getPrimitiveBounds(unsigned int primitive, Vec3 &min, Vec3 &max)
+{
+    const uint32_t *positionIndices = &m_PositionIndices[3 * static_cast<size_t>(primitive)];
+    min = m_Positions[positionIndices[0]];
+    max = min;
+    for (int corner = 1; corner < 3; corner++)
+    {
+        const Vec3 &position = m_Positions[positionIndices[corner]];
+        min = Vec3(std::min(min.x, position.x), std::min(min.y, position.y), std::min(min.z, position.z));
+        max = Vec3(std::max(max.x, position.x), std::max(max.y, position.y), std::max(max.z, position.z));
+    }
+}
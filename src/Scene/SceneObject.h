@@ -1,23 +1,93 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "RayTracer/Hit.h"
 #include "RayTracer/Ray.h"
+#include "Utils/DataBuffer.h"
 #include "Utils/Vec3.h"
 
+/**
+ * the closest intersection found while a ray traverses the scene
+ *
+ * only what the intersection test computes anyway is recorded, the position, normal and material of the hit are
+ * resolved with SceneObject::shadeHit once the closest hit is known
+ */
+struct PrimitiveHit
+{
+    float time = INFINITY;
+
+    // barycentric coordinates of the hit on a triangle, the weights of its second and third corner
+    float u = 0.0f;
+    float v = 0.0f;
+
+    uint32_t object = 0;
+    uint32_t primitive = 0;
+
+    // the triangle of the instanced mesh that was hit if the object is a mesh instance
+    uint32_t instancePrimitive = 0;
+};
+
 /**
  * the base class of all objects in a scene
+ *
+ * an object is made of one or more primitives, the BVH is built over the primitives and refers to them by index
  */
 class SceneObject
 {
   public:
     virtual ~SceneObject() = default;
-    virtual Vec3 getNormal(Vec3 position) = 0;
-    virtual Hit rayIntersect(Ray ray) = 0;
     virtual Vec3 getCenterPoint() = 0;
 
-    void setMaterialName(std::string &name);
+    /**
+     * records the hit of a ray with a primitive of the object if it is closer than the closest hit so far
+     *
+     * \param closest - the closest hit so far, its time and barycentric coordinates are set if the primitive is closer
+     * \return - true if the primitive is the new closest hit, the caller sets the object and primitive of the hit
+     */
+    virtual bool rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) = 0;
+
+    /**
+     * resolves the position, normal and material of a hit recorded by rayIntersect
+     */
+    virtual Hit shadeHit(Ray ray, const PrimitiveHit &primitiveHit) = 0;
+
+    /**
+     * the time the ray first hits a primitive of the object, without filling in a hit
+     *
+     * \return - the hit time, INFINITY if the ray misses the primitive
+     */
+    virtual float rayHitTime(Ray ray, unsigned int primitive) = 0;
+
+    /**
+     * checks if a primitive of the object blocks a ray at or before maxTime
+     */
+    virtual bool rayOccluded(Ray ray, unsigned int primitive, float maxTime)
+    {
+        return rayHitTime(ray, primitive) <= maxTime;
+    }
+
+    /**
+     * objects other than meshes are a single primitive
+     */
+    virtual unsigned int getNumPrimitives()
+    {
+        return 1;
+    }
+
+    virtual Vec3 getPrimitiveCenter(unsigned int primitive)
+    {
+        return getCenterPoint();
+    }
+
+    virtual void getPrimitiveBounds(unsigned int primitive, Vec3 &min, Vec3 &max)
+    {
+        min = Vec3(minX, minY, minZ);
+        max = Vec3(maxX, maxY, maxZ);
+    }
+
+    void setMaterialId(unsigned int materialId);
 
     float getMinX()
     {
@@ -45,7 +115,7 @@ class SceneObject
     }
 
   protected:
-    std::string m_MaterialName;
+    unsigned int m_MaterialId = 0;
     float minX, minY, minZ;
     float maxX, maxY, maxZ;
 };
@@ -58,9 +128,10 @@ class Triangle : public SceneObject
     Triangle(Vec3 p0, Vec3 p1, Vec3 p2);
     Triangle(Vec3 p0, Vec3 n0, Vec3 p1, Vec3 n1, Vec3 p2, Vec3 n2);
 
-    Vec3 getNormal(Vec3 position) override;
-    Hit rayIntersect(Ray ray) override;
+    bool rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) override;
+    Hit shadeHit(Ray ray, const PrimitiveHit &primitiveHit) override;
     Vec3 getCenterPoint() override;
+    float rayHitTime(Ray ray, unsigned int primitive) override;
     auto getPoints() -> std::vector<Vec3>;
 
   private:
@@ -80,11 +151,92 @@ class Sphere : public SceneObject
     ~Sphere() override = default;
     Sphere(Vec3 center, float radius);
 
-    Vec3 getNormal(Vec3 position) override;
-    Hit rayIntersect(Ray ray) override;
+    Vec3 getNormal(Vec3 position);
+    bool rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) override;
+    Hit shadeHit(Ray ray, const PrimitiveHit &primitiveHit) override;
     Vec3 getCenterPoint() override;
+    float rayHitTime(Ray ray, unsigned int primitive) override;
 
   private:
     Vec3 m_Center{};
     float m_Radius;
 };
+
+/**
+ * a mesh of triangles that share their vertices and normals
+ *
+ * the mesh is a structure of arrays, the vertex positions and normals are stored once and every triangle is
+ * three indices into each, so a triangle costs 24 bytes plus its share of the vertices instead of a whole object
+ */
+class TriangleMesh : public SceneObject
+{
+  public:
+    ~TriangleMesh() override = default;
+    TriangleMesh(std::vector<Vec3> positions, std::vector<Vec3> normals);
+
+    /**
+     * creates a mesh from three position and normal indices per triangle
+     * the normal indices of a triangle with a flat normal are flatNormal
+     */
+    TriangleMesh(DataBuffer<Vec3> positions, DataBuffer<Vec3> normals, DataBuffer<uint32_t> positionIndices,
+                 DataBuffer<uint32_t> normalIndices);
+
+    /**
+     * adds a triangle with a flat normal
+     */
+    void addTriangle(uint32_t p0, uint32_t p1, uint32_t p2);
+
+    /**
+     * adds a triangle whose normal is interpolated from the normals at its corners
+     */
+    void addTriangle(uint32_t p0, uint32_t n0, uint32_t p1, uint32_t n1, uint32_t p2, uint32_t n2);
+
+    /**
+     * moves the vertices of the mesh, the triangles keep their indices so there must be as many positions as before
+     */
+    void setPositions(DataBuffer<Vec3> positions);
+
+    bool rayIntersect(Ray ray, unsigned int primitive, PrimitiveHit &closest) override;
+    Hit shadeHit(Ray ray, const PrimitiveHit &primitiveHit) override;
+    Vec3 getCenterPoint() override;
+    float rayHitTime(Ray ray, unsigned int primitive) override;
+    bool rayOccluded(Ray ray, unsigned int primitive, float maxTime) override;
+
+    unsigned int getNumPrimitives() override;
+    Vec3 getPrimitiveCenter(unsigned int primitive) override;
+    void getPrimitiveBounds(unsigned int primitive, Vec3 &min, Vec3 &max) override;
+
+    auto inline getPositions() const -> const DataBuffer<Vec3> &
+    {
+        return m_Positions;
+    }
+
+    auto inline getNormals() const -> const DataBuffer<Vec3> &
+    {
+        return m_Normals;
+    }
+
+    auto inline getPositionIndices() const -> const DataBuffer<uint32_t> &
+    {
+        return m_PositionIndices;
+    }
+
+    auto inline getNormalIndices() const -> const DataBuffer<uint32_t> &
+    {
+        return m_NormalIndices;
+    }
+
+    // the normal index of the corners of a triangle with a flat normal
+    static constexpr uint32_t flatNormal = UINT32_MAX;
+
+  private:
+    void computeBounds();
+
+    // the arrays of a mesh loaded from a scene cache view the mapped cache file
+    DataBuffer<Vec3> m_Positions{};
+    DataBuffer<Vec3> m_Normals{};
+
+    // three indices per triangle
+    DataBuffer<uint32_t> m_PositionIndices{};
+    DataBuffer<uint32_t> m_NormalIndices{};
+};
@@ -0,0 +1,40 @@
+#include "SceneView.h"
+
+/**
+ * compiles the render snapshot of a scene, the scene's acceleration structure must already be built
+ *
+ * \param scene - the scene to snapshot
+ */
+SceneView::SceneView(Scene &scene)
+    : m_AccelerationStructure(scene.getAccelerationStructure().get()), m_Materials(scene.getMaterials()),
+      m_AmbientLighting(scene.getAmbientLighting())
+{
+    for (const std::shared_ptr<Light> &light : scene.getLightList())
+    {
+        m_Lights.push_back(*light);
+    }
+
+    // the view plane is spanned by the world x and y axes one unit in front of the camera
+    Camera camera = scene.getCamera();
+    m_CameraOrg = camera.org;
+    m_ViewPlaneCenter = camera.org + camera.dir;
+    m_CameraRight = Vec3(1.0f, 0.0f, 0.0f);
+    m_CameraUp = Vec3(0.0f, 1.0f, 0.0f);
+}
+
+auto SceneView::rayHitLight(const Ray &ray, float maxTime, const Light *&light) const -> float
+{
+    light = nullptr;
+    float closestTime = INFINITY;
+    for (const Light &sceneLight : m_Lights)
+    {
+        float time = sceneLight.rayHitTime(ray);
+        if (time < maxTime && time < closestTime)
+        {
+            closestTime = time;
+            light = &sceneLight;
+        }
+    }
+
+    return closestTime;
+}
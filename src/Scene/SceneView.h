@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+
+#include "BVH.h"
+#include "Light.h"
+#include "Material.h"
+#include "Scene.h"
+
+/**
+ * a read only snapshot of a scene compiled for rendering
+ *
+ * the lights and materials are copied into contiguous arrays and the camera's view plane is precomputed, so render
+ * threads read plain data instead of copying shared pointers and light lists for every sample. The BVH is referenced,
+ * not copied, so the scene must outlive the view and must not be changed while it is in use.
+ */
+class SceneView
+{
+  public:
+    explicit SceneView(Scene &scene);
+
+    /**
+     * finds the closest hit of a ray with the scene, isHit is false if the ray hits nothing
+     */
+    auto inline rayIntersect(Ray ray) const -> Hit
+    {
+        return m_AccelerationStructure ? m_AccelerationStructure->rayIntersect(ray) : Hit();
+    }
+
+    /**
+     * checks if anything in the scene blocks a ray at or before maxTime
+     */
+    auto inline rayOccluded(Ray ray, float maxTime) const -> bool
+    {
+        return m_AccelerationStructure && m_AccelerationStructure->rayOccluded(ray, maxTime);
+    }
+
+    /**
+     * finds the closest light a ray hits before maxTime, lights are not part of the BVH
+     *
+     * \param ray - the ray to test
+     * \param maxTime - lights hit after this time are ignored
+     * \param light - set to the light that is hit, nullptr if no light is hit
+     * \return - the time the ray hits the light, INFINITY if no light is hit
+     */
+    auto rayHitLight(const Ray &ray, float maxTime, const Light *&light) const -> float;
+
+    auto inline getMaterial(unsigned int materialId) const -> const Material &
+    {
+        return m_Materials[materialId];
+    }
+
+    auto inline getLights() const -> const std::vector<Light> &
+    {
+        return m_Lights;
+    }
+
+    auto inline getAmbientLighting() const -> const Vec3 &
+    {
+        return m_AmbientLighting;
+    }
+
+    auto inline getCameraOrg() const -> const Vec3 &
+    {
+        return m_CameraOrg;
+    }
+
+    /**
+     * the point one unit in front of the camera that the view plane is centered on
+     */
+    auto inline getViewPlaneCenter() const -> const Vec3 &
+    {
+        return m_ViewPlaneCenter;
+    }
+
+    /**
+     * the directions of the view plane's horizontal and vertical axes
+     */
+    auto inline getCameraRight() const -> const Vec3 &
+    {
+        return m_CameraRight;
+    }
+
+    auto inline getCameraUp() const -> const Vec3 &
+    {
+        return m_CameraUp;
+    }
+
+  private:
+    const BVH *m_AccelerationStructure;
+    std::vector<Light> m_Lights;
+    std::vector<Material> m_Materials;
+    Vec3 m_AmbientLighting;
+
+    Vec3 m_CameraOrg;
+    Vec3 m_ViewPlaneCenter;
+    Vec3 m_CameraRight;
+    Vec3 m_CameraUp;
+};
@@ -0,0 +1,394 @@
+#include "WideBVH.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PATH_TRACER_X86
+#include <immintrin.h>
+#endif
+
+// gcc and clang only emit AVX instructions in functions marked for it, msvc emits them anywhere
+#if defined(__GNUC__)
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+
+template <unsigned int Width>
+using ChildTestFunction = unsigned int (*)(const WideBVHNode<Width> &node, const TraversalRay &ray, float maxTime,
+                                           float *entryTimes);
+
+/**
+ * slab tests of the child boxes one at a time
+ */
+template <unsigned int Width>
+static auto childTestScalar(const WideBVHNode<Width> &node, const TraversalRay &ray, float maxTime,
+                            float *entryTimes) -> unsigned int
+{
+    unsigned int hitMask = 0;
+    for (unsigned int i = 0; i < Width; i++)
+    {
+        float tEnter = 0.0f;
+        float tExit = maxTime;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float nearPlane = ray.dirNegative[axis] ? node.boundsMax[axis][i] : node.boundsMin[axis][i];
+            float farPlane = ray.dirNegative[axis] ? node.boundsMin[axis][i] : node.boundsMax[axis][i];
+            tEnter = std::max(tEnter, (nearPlane - ray.org[axis]) * ray.invDir[axis]);
+            tExit = std::min(tExit, (farPlane - ray.org[axis]) * ray.invDir[axis]);
+        }
+
+        entryTimes[i] = tEnter;
+        hitMask |= (tEnter <= tExit ? 1U : 0U) << i;
+    }
+    return hitMask;
+}
+
+#ifdef PATH_TRACER_X86
+/**
+ * slab tests of the four child boxes with one SSE instruction per plane
+ */
+static auto childTestSSE(const WideBVHNode<4> &node, const TraversalRay &ray, float maxTime, float *entryTimes)
+    -> unsigned int
+{
+    __m128 tEnter = _mm_setzero_ps();
+    __m128 tExit = _mm_set1_ps(maxTime);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float *nearPlanes = ray.dirNegative[axis] ? node.boundsMax[axis] : node.boundsMin[axis];
+        const float *farPlanes = ray.dirNegative[axis] ? node.boundsMin[axis] : node.boundsMax[axis];
+        __m128 org = _mm_set1_ps(ray.org[axis]);
+        __m128 invDir = _mm_set1_ps(ray.invDir[axis]);
+        tEnter = _mm_max_ps(tEnter, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearPlanes), org), invDir));
+        tExit = _mm_min_ps(tExit, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farPlanes), org), invDir));
+    }
+
+    _mm_storeu_ps(entryTimes, tEnter);
+    return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(tEnter, tExit)));
+}
+
+/**
+ * slab tests of the eight child boxes with one AVX instruction per plane
+ */
+TARGET_AVX static auto childTestAVX(const WideBVHNode<8> &node, const TraversalRay &ray, float maxTime,
+                                    float *entryTimes) -> unsigned int
+{
+    __m256 tEnter = _mm256_setzero_ps();
+    __m256 tExit = _mm256_set1_ps(maxTime);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float *nearPlanes = ray.dirNegative[axis] ? node.boundsMax[axis] : node.boundsMin[axis];
+        const float *farPlanes = ray.dirNegative[axis] ? node.boundsMin[axis] : node.boundsMax[axis];
+        __m256 org = _mm256_set1_ps(ray.org[axis]);
+        __m256 invDir = _mm256_set1_ps(ray.invDir[axis]);
+        tEnter = _mm256_max_ps(tEnter, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nearPlanes), org), invDir));
+        tExit = _mm256_min_ps(tExit, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(farPlanes), org), invDir));
+    }
+
+    _mm256_storeu_ps(entryTimes, tEnter);
+    return static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(tEnter, tExit, _CMP_LE_OQ)));
+}
+#endif
+
+/**
+ * picks the child test of a 4 wide node, simdLevel is lowered to the instructions actually used
+ */
+static auto selectChildTest(SimdLevel &simdLevel, const WideBVHNode<4> *) -> ChildTestFunction<4>
+{
+#ifdef PATH_TRACER_X86
+    if (simdLevel != SimdLevel::Scalar)
+    {
+        simdLevel = SimdLevel::SSE;
+        return childTestSSE;
+    }
+#endif
+    simdLevel = SimdLevel::Scalar;
+    return childTestScalar<4>;
+}
+
+/**
+ * picks the child test of an 8 wide node, simdLevel is lowered to the instructions actually used
+ */
+static auto selectChildTest(SimdLevel &simdLevel, const WideBVHNode<8> *) -> ChildTestFunction<8>
+{
+#ifdef PATH_TRACER_X86
+    if (simdLevel == SimdLevel::AVX)
+    {
+        return childTestAVX;
+    }
+#endif
+    simdLevel = SimdLevel::Scalar;
+    return childTestScalar<8>;
+}
+
+/**
+ * the surface area of a binary node's bounds
+ */
+static auto surfaceArea(const LinearBVHNode &node) -> float
+{
+    return BoundingBox(node.boundsMin[0], node.boundsMax[0], node.boundsMin[1], node.boundsMax[1],
+                       node.boundsMin[2], node.boundsMax[2])
+        .surfaceArea();
+}
+
+template <unsigned int Width>
+WideBVH<Width>::WideBVH(const DataBuffer<LinearBVHNode> &binaryNodes,
+                        const std::vector<std::shared_ptr<SceneObject>> &objectList,
+                        const DataBuffer<PrimitiveRef> &primitives, SimdLevel simdLevel,
+                        DataBuffer<WideBVHNode<Width>> nodes)
+    : m_Nodes(std::move(nodes)), m_OjectList(objectList), m_Primitives(primitives), m_SimdLevel(simdLevel)
+{
+    m_ChildTest = selectChildTest(m_SimdLevel, static_cast<const WideBVHNode<Width> *>(nullptr));
+
+    if (m_Nodes.empty() && !binaryNodes.empty())
+    {
+        // collapsing removes at least one binary node per wide node
+        m_BuildNodes.reserve(binaryNodes.size() / (Width - 1) + 1);
+        m_Sources.reserve(m_BuildNodes.capacity() * Width);
+        collapse(binaryNodes, 0);
+        m_Nodes = std::move(m_BuildNodes);
+    }
+}
+
+/**
+ * creates the wide node for a binary subtree, its children are the largest binary nodes below the subtree's root
+ *
+ * \return - the index of the wide node
+ */
+template <unsigned int Width>
+auto WideBVH<Width>::collapse(const DataBuffer<LinearBVHNode> &binaryNodes, uint32_t binaryIndex) -> uint32_t
+{
+    uint32_t children[Width];
+    unsigned int numChildren = 0;
+
+    const LinearBVHNode &binaryNode = binaryNodes[binaryIndex];
+    if (binaryNode.isLeaf())
+    {
+        children[numChildren++] = binaryIndex;
+    }
+    else
+    {
+        children[numChildren++] = binaryNode.offset;
+        children[numChildren++] = binaryNode.offset + 1;
+    }
+
+    // the inner child with the largest surface area is replaced by its children until the node is full,
+    // opening the boxes rays are most likely to hit saves the most traversal steps
+    while (numChildren < Width)
+    {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (unsigned int i = 0; i < numChildren; i++)
+        {
+            const LinearBVHNode &child = binaryNodes[children[i]];
+            if (!child.isLeaf() && surfaceArea(child) > largestArea)
+            {
+                largest = static_cast<int>(i);
+                largestArea = surfaceArea(child);
+            }
+        }
+
+        if (largest < 0)
+        {
+            break;
+        }
+
+        uint32_t opened = binaryNodes[children[largest]].offset;
+        children[largest] = opened;
+        children[numChildren++] = opened + 1;
+    }
+
+    auto nodeIndex = static_cast<uint32_t>(m_BuildNodes.size());
+    m_BuildNodes.emplace_back();
+    m_Sources.resize(m_BuildNodes.size() * Width, noSource);
+
+    for (unsigned int i = 0; i < Width; i++)
+    {
+        float boundsMin[3] = {std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+                              std::numeric_limits<float>::infinity()};
+        float boundsMax[3] = {-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                              -std::numeric_limits<float>::infinity()};
+        uint32_t child = 0;
+        uint32_t numObjects = 0;
+
+        if (i < numChildren)
+        {
+            m_Sources[nodeIndex * Width + i] = children[i];
+            const LinearBVHNode &binaryChild = binaryNodes[children[i]];
+            std::copy(binaryChild.boundsMin, binaryChild.boundsMin + 3, boundsMin);
+            std::copy(binaryChild.boundsMax, binaryChild.boundsMax + 3, boundsMax);
+            if (binaryChild.isLeaf())
+            {
+                child = binaryChild.offset;
+                numObjects = binaryChild.numObjects;
+            }
+            else
+            {
+                child = collapse(binaryNodes, children[i]);
+            }
+        }
+
+        // collapsing the child may have moved the nodes
+        WideBVHNode<Width> &node = m_BuildNodes[nodeIndex];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            node.boundsMin[axis][i] = boundsMin[axis];
+            node.boundsMax[axis][i] = boundsMax[axis];
+        }
+        node.child[i] = child;
+        node.numObjects[i] = numObjects;
+    }
+
+    return nodeIndex;
+}
+
+template <unsigned int Width>
+void WideBVH<Width>::refit(const DataBuffer<LinearBVHNode> &binaryNodes, unsigned int begin, unsigned int end)
+{
+    // only nodes collapsed here can be refit and those are owned, so no copy is made while threads share them
+    WideBVHNode<Width> *nodes = m_Nodes.mutableData();
+    for (unsigned int nodeIndex = begin; nodeIndex < end; nodeIndex++)
+    {
+        WideBVHNode<Width> &node = nodes[nodeIndex];
+        for (unsigned int i = 0; i < Width; i++)
+        {
+            uint32_t source = m_Sources[nodeIndex * Width + i];
+            if (source == noSource)
+            {
+                continue;
+            }
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                node.boundsMin[axis][i] = binaryNodes[source].boundsMin[axis];
+                node.boundsMax[axis][i] = binaryNodes[source].boundsMax[axis];
+            }
+        }
+    }
+}
+
+template <unsigned int Width> auto WideBVH<Width>::closestHit(Ray ray, float maxTime) const -> PrimitiveHit
+{
+    PrimitiveHit hit;
+    hit.time = maxTime;
+    if (m_Nodes.empty())
+    {
+        return hit;
+    }
+
+    TraversalRay traversalRay(ray);
+
+    struct StackEntry
+    {
+        uint32_t child;
+        uint32_t numObjects;
+        float entryTime;
+    };
+
+    // every level leaves at most Width - 1 children on the stack
+    StackEntry stack[BVH::maxDepth * Width];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = {0, 0, 0.0f};
+
+    while (stackSize > 0)
+    {
+        StackEntry entry = stack[--stackSize];
+        if (entry.entryTime > hit.time)
+        {
+            continue;
+        }
+
+        if (entry.numObjects > 0)
+        {
+            for (uint32_t i = entry.child; i < entry.child + entry.numObjects; i++)
+            {
+                const PrimitiveRef &primitive = m_Primitives[i];
+                if (m_OjectList[primitive.object]->rayIntersect(ray, primitive.primitive, hit))
+                {
+                    hit.object = primitive.object;
+                    hit.primitive = primitive.primitive;
+                }
+            }
+            continue;
+        }
+
+        const WideBVHNode<Width> &node = m_Nodes[entry.child];
+        alignas(32) float entryTimes[Width];
+        unsigned int hitMask = m_ChildTest(node, traversalRay, hit.time, entryTimes);
+
+        // the children that are hit are sorted onto the stack farthest first so the nearest is popped next
+        unsigned int firstPushed = stackSize;
+        for (unsigned int i = 0; i < Width; i++)
+        {
+            if ((hitMask >> i) & 1U)
+            {
+                StackEntry child{node.child[i], node.numObjects[i], entryTimes[i]};
+                unsigned int slot = stackSize++;
+                while (slot > firstPushed && stack[slot - 1].entryTime < child.entryTime)
+                {
+                    stack[slot] = stack[slot - 1];
+                    slot--;
+                }
+                stack[slot] = child;
+            }
+        }
+    }
+
+    return hit;
+}
+
+template <unsigned int Width> auto WideBVH<Width>::rayOccluded(Ray ray, float maxTime) const -> bool
+{
+    if (m_Nodes.empty())
+    {
+        return false;
+    }
+
+    TraversalRay traversalRay(ray);
+
+    struct StackEntry
+    {
+        uint32_t child;
+        uint32_t numObjects;
+    };
+
+    StackEntry stack[BVH::maxDepth * Width];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = {0, 0};
+
+    while (stackSize > 0)
+    {
+        StackEntry entry = stack[--stackSize];
+        if (entry.numObjects > 0)
+        {
+            for (uint32_t i = entry.child; i < entry.child + entry.numObjects; i++)
+            {
+                const PrimitiveRef &primitive = m_Primitives[i];
+                if (m_OjectList[primitive.object]->rayOccluded(ray, primitive.primitive, maxTime))
+                {
+                    return true;
+                }
+            }
+            continue;
+        }
+
+        const WideBVHNode<Width> &node = m_Nodes[entry.child];
+        alignas(32) float entryTimes[Width];
+        unsigned int hitMask = m_ChildTest(node, traversalRay, maxTime, entryTimes);
+
+        // any blocker ends the search so the children are not sorted by distance
+        for (unsigned int i = 0; i < Width; i++)
+        {
+            if ((hitMask >> i) & 1U)
+            {
+                stack[stackSize++] = {node.child[i], node.numObjects[i]};
+            }
+        }
+    }
+
+    return false;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "BVH.h"
+#include "SceneObject.h"
+#include "Utils/CpuFeatures.h"
+
+/**
+ * a BVH with up to Width children per node, collapsed from a binary BVH
+ *
+ * each node tests the ray against all its child boxes at once with SSE for 4 wide nodes and AVX for 8 wide nodes,
+ * the children that are hit are visited nearest first, a scalar loop is used if the CPU lacks the instructions
+ */
+template <unsigned int Width> class WideBVH
+{
+  public:
+    /**
+     * \param binaryNodes - the flattened binary BVH, node 0 is the root
+     * \param objectList - the objects the primitives belong to, must outlive the wide BVH
+     * \param primitives - the primitives the leaves of the binary BVH reference, must outlive the wide BVH
+     * \param simdLevel - the instructions the child boxes are tested with
+     * \param nodes - the wide nodes the binary BVH was collapsed into before, it is collapsed again if empty
+     */
+    WideBVH(const DataBuffer<LinearBVHNode> &binaryNodes, const std::vector<std::shared_ptr<SceneObject>> &objectList,
+            const DataBuffer<PrimitiveRef> &primitives, SimdLevel simdLevel,
+            DataBuffer<WideBVHNode<Width>> nodes = {});
+
+    /**
+     * finds the closest primitive a ray hits before maxTime, the hit is not shaded
+     */
+    auto closestHit(Ray ray, float maxTime) const -> PrimitiveHit;
+
+    /**
+     * checks if any object blocks a ray at or before maxTime
+     */
+    auto rayOccluded(Ray ray, float maxTime) const -> bool;
+
+    /**
+     * true if the tree was collapsed here and knows the binary node behind each child, a tree loaded from a cache
+     * has to be collapsed again after a refit
+     */
+    auto inline canRefit() const -> bool
+    {
+        return !m_Nodes.empty() && m_Sources.size() == m_Nodes.size() * Width;
+    }
+
+    /**
+     * copies the bounds of the refit binary tree into the children of a range of nodes
+     */
+    void refit(const DataBuffer<LinearBVHNode> &binaryNodes, unsigned int begin, unsigned int end);
+
+    auto inline getNumNodes() const -> unsigned int
+    {
+        return static_cast<unsigned int>(m_Nodes.size());
+    }
+
+    auto inline getNodes() const -> const DataBuffer<WideBVHNode<Width>> &
+    {
+        return m_Nodes;
+    }
+
+    auto inline getSimdLevel() const -> SimdLevel
+    {
+        return m_SimdLevel;
+    }
+
+  private:
+    /**
+     * tests a ray against the child boxes of a node
+     *
+     * \param entryTimes - set to the time the ray enters each child box
+     * \return - bit i is set if the ray enters child i between its origin and maxTime
+     */
+    using ChildTest = unsigned int (*)(const WideBVHNode<Width> &node, const TraversalRay &ray, float maxTime,
+                                       float *entryTimes);
+
+    auto collapse(const DataBuffer<LinearBVHNode> &binaryNodes, uint32_t binaryIndex) -> uint32_t;
+
+    DataBuffer<WideBVHNode<Width>> m_Nodes{};
+    std::vector<WideBVHNode<Width>> m_BuildNodes{};
+
+    // the binary node each child was collapsed from, Width per node, noSource for unused children
+    std::vector<uint32_t> m_Sources{};
+    static constexpr uint32_t noSource = UINT32_MAX;
+    const std::vector<std::shared_ptr<SceneObject>> &m_OjectList;
+    const DataBuffer<PrimitiveRef> &m_Primitives;
+    SimdLevel m_SimdLevel;
+    ChildTest m_ChildTest;
+};
+
+extern template class WideBVH<4>;
+extern template class WideBVH<8>;
@@ -1,15 +1,62 @@
 #include "Config.h"
 
 #include <fstream>
+#include <stdexcept>
 
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 
-Config::Config(std::string filePath) : fps(30), numThreads(1), numChildrenInBVHLeafNodes(25)
+Config::Config(std::string filePath)
+    : fps(30), numThreads(1), numChildrenInBVHLeafNodes(25), bvhBuilder(BVHBuilder::SAH), sahTraversalCost(1.0f),
+      sahIntersectionCost(1.0f), bvhWidth(0), bvhRebuildCostRatio(1.5f), sceneCache(false), shadowProbeRays(0),
+      integrator(Integrator::BlinnPhong), russianRouletteDepth(3), sampler(SamplerType::Sobol), samplesPerPixel(64),
+      timeLimit(0.0f), tileSize(16), noiseThreshold(0.0f), minAdaptiveSamples(8)
 {
     loadConfig(filePath);
 }
 
+auto Config::getBVHBuildSettings() const -> BVHBuildSettings
+{
+    BVHBuildSettings settings;
+    settings.builder = bvhBuilder;
+    settings.maxObjectsInLeaf = numChildrenInBVHLeafNodes;
+    settings.traversalCost = sahTraversalCost;
+    settings.intersectionCost = sahIntersectionCost;
+    settings.width = bvhWidth;
+    settings.rebuildCostRatio = bvhRebuildCostRatio;
+    return settings;
+}
+
+auto Config::parseIntegrator(const std::string &name) -> Integrator
+{
+    if (name == "blinnPhong")
+    {
+        return Integrator::BlinnPhong;
+    }
+    if (name == "path")
+    {
+        return Integrator::Path;
+    }
+    throw std::invalid_argument("Unknown integrator '" + name + "', use blinnPhong or path!");
+}
+
+auto Config::parseSampler(const std::string &name) -> SamplerType
+{
+    if (name == "random")
+    {
+        return SamplerType::Random;
+    }
+    if (name == "sobol")
+    {
+        return SamplerType::Sobol;
+    }
+    if (name == "blueNoise")
+    {
+        return SamplerType::BlueNoise;
+    }
+    throw std::invalid_argument("Unknown sampler '" + name + "', use random, sobol or blueNoise!");
+}
+
 void Config::loadConfig(std::string filePath)
 {
     std::ifstream f(filePath);
@@ -23,4 +70,30 @@ void Config::loadConfig(std::string filePath)
     numChildrenInBVHLeafNodes = data[m_keywrods.numChildrenInBVHLeafNodes];
     numShadowRays = data[m_keywrods.numShadowRays];
     maxRecurseLevel = data[m_keywrods.maxRecurseLevel];
+
+    // optional settings keep their defaults when missing
+    if (data.contains(m_keywrods.bvhBuilder))
+    {
+        bvhBuilder = parseBVHBuilder(data[m_keywrods.bvhBuilder].get<std::string>());
+    }
+    sahTraversalCost = data.value(m_keywrods.sahTraversalCost, sahTraversalCost);
+    sahIntersectionCost = data.value(m_keywrods.sahIntersectionCost, sahIntersectionCost);
+    bvhWidth = data.value(m_keywrods.bvhWidth, bvhWidth);
+    bvhRebuildCostRatio = data.value(m_keywrods.bvhRebuildCostRatio, bvhRebuildCostRatio);
+    sceneCache = data.value(m_keywrods.sceneCache, sceneCache);
+    shadowProbeRays = data.value(m_keywrods.shadowProbeRays, shadowProbeRays);
+    if (data.contains(m_keywrods.integrator))
+    {
+        integrator = parseIntegrator(data[m_keywrods.integrator].get<std::string>());
+    }
+    russianRouletteDepth = data.value(m_keywrods.russianRouletteDepth, russianRouletteDepth);
+    if (data.contains(m_keywrods.sampler))
+    {
+        sampler = parseSampler(data[m_keywrods.sampler].get<std::string>());
+    }
+    samplesPerPixel = data.value(m_keywrods.samplesPerPixel, samplesPerPixel);
+    timeLimit = data.value(m_keywrods.timeLimit, timeLimit);
+    tileSize = data.value(m_keywrods.tileSize, tileSize);
+    noiseThreshold = data.value(m_keywrods.noiseThreshold, noiseThreshold);
+    minAdaptiveSamples = data.value(m_keywrods.minAdaptiveSamples, minAdaptiveSamples);
 }
\ No newline at end of file
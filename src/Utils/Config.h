@@ -2,8 +2,21 @@
 #include <string>
 #include <vector>
 
+#include "Sampler.h"
 #include "Scene/Scene.h"
 
+/**
+ * the ways the ray tracer can compute the color of a camera ray
+ */
+enum class Integrator
+{
+    // recursive Blinn-Phong lighting, reflections are traced once per light
+    BlinnPhong,
+
+    // iterative path with one continuation ray per bounce weighted by the path throughput
+    Path
+};
+
 class Config
 {
   private:
@@ -14,8 +27,23 @@ class Config
         const std::string fps = "fps";
         const std::string numThreads = "numThreads";
         const std::string numChildrenInBVHLeafNodes = "numChildrenInBVHLeafNodes";
+        const std::string bvhBuilder = "bvhBuilder";
+        const std::string sahTraversalCost = "sahTraversalCost";
+        const std::string sahIntersectionCost = "sahIntersectionCost";
+        const std::string bvhWidth = "bvhWidth";
+        const std::string bvhRebuildCostRatio = "bvhRebuildCostRatio";
+        const std::string sceneCache = "sceneCache";
         const std::string numShadowRays = "numShadowRays";
+        const std::string shadowProbeRays = "shadowProbeRays";
         const std::string maxRecurseLevel = "maxRecurseLevel";
+        const std::string integrator = "integrator";
+        const std::string russianRouletteDepth = "russianRouletteDepth";
+        const std::string sampler = "sampler";
+        const std::string samplesPerPixel = "samplesPerPixel";
+        const std::string timeLimit = "timeLimit";
+        const std::string tileSize = "tileSize";
+        const std::string noiseThreshold = "noiseThreshold";
+        const std::string minAdaptiveSamples = "minAdaptiveSamples";
     };
     Keywords m_keywrods;
 
@@ -25,12 +53,58 @@ class Config
     unsigned int fps;
     unsigned int numThreads;
     unsigned int numChildrenInBVHLeafNodes;
+
+    // "sah" or "morton", how the BVHs are built, Morton builds are far faster but trace slower
+    BVHBuilder bvhBuilder;
+
+    // surface area heuristic costs of visiting a BVH node and of intersecting one object
+    float sahTraversalCost;
+    float sahIntersectionCost;
+
+    // children per BVH node rays are traced with, 2, 4 or 8, 0 picks by the CPU's vector instructions
+    unsigned int bvhWidth;
+
+    // a BVH refit for an animation frame is rebuilt once its surface area heuristic cost grows past this multiple of
+    // its cost after the last build
+    float bvhRebuildCostRatio;
+
+    // map the models and BVH from a cache file written next to the scene file on the first launch
+    bool sceneCache;
+
     unsigned int numShadowRays;
+
+    // shadow rays shot first to test if a position is in the penumbra, 0 always shoots all numShadowRays
+    unsigned int shadowProbeRays;
     unsigned int maxRecurseLevel;
 
+    // "blinnPhong" or "path"
+    Integrator integrator;
+
+    // bounces of the path integrator before paths can be ended by russian roulette
+    unsigned int russianRouletteDepth;
+
+    // the sequence the pixel positions, light samples and bounce directions are drawn from,
+    // "random", "sobol" or "blueNoise"
+    SamplerType sampler;
+
+    // headless render budget, rendering stops at whichever is reached first
+    unsigned int samplesPerPixel;
+    float timeLimit; // seconds, 0 means no time limit
+
+    int tileSize; // width and height in pixels of the tiles the workers render
+
+    // adaptive sampling stops sampling tiles whose relative error is below noiseThreshold, 0 disables it
+    float noiseThreshold;
+    unsigned int minAdaptiveSamples;
+
   public:
     Config(std::string filePath);
 
+    auto getBVHBuildSettings() const -> BVHBuildSettings;
+
   private:
+    static auto parseIntegrator(const std::string &name) -> Integrator;
+    static auto parseSampler(const std::string &name) -> SamplerType;
+
     void loadConfig(std::string filePath);
 };
\ No newline at end of file
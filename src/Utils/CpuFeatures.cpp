@@ -0,0 +1,46 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+auto CpuFeatures::getSimdLevel() -> SimdLevel
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 1);
+
+    // the CPU has AVX and the operating system saves the ymm registers on a context switch
+    bool osSavesRegisters = (info[2] & (1 << 27)) != 0;
+    bool hasAVX = (info[2] & (1 << 28)) != 0;
+    if (osSavesRegisters && hasAVX && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        return SimdLevel::AVX;
+    }
+    return (info[3] & (1 << 26)) != 0 ? SimdLevel::SSE : SimdLevel::Scalar;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    // the avx check of the builtin includes the operating system support
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+    {
+        return SimdLevel::AVX;
+    }
+    return __builtin_cpu_supports("sse2") ? SimdLevel::SSE : SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+auto CpuFeatures::toString(SimdLevel simdLevel) -> const char *
+{
+    switch (simdLevel)
+    {
+    case SimdLevel::AVX:
+        return "AVX";
+    case SimdLevel::SSE:
+        return "SSE";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+/**
+ * the widest vector instruction set the code paths that have several versions may use
+ */
+enum class SimdLevel
+{
+    Scalar,
+    SSE,
+    AVX
+};
+
+/**
+ * queries the features of the CPU the program is running on
+ */
+class CpuFeatures
+{
+  public:
+    /**
+     * the widest instruction set that both the CPU and the operating system support, always Scalar off x86
+     */
+    static auto getSimdLevel() -> SimdLevel;
+
+    static auto toString(SimdLevel simdLevel) -> const char *;
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "MappedFile.h"
+
+/**
+ * an array that either owns its elements or views elements stored in a memory mapped file
+ *
+ * a view keeps the file mapped for as long as it exists, so data loaded from a cache is read straight out of the
+ * page cache without being copied, only an owning buffer can be appended to, a view is copied into an owning buffer
+ * the first time its elements are changed so the file is never written
+ */
+template <typename T> class DataBuffer
+{
+  public:
+    DataBuffer() = default;
+
+    DataBuffer(std::vector<T> elements) : m_Elements(std::move(elements))
+    {
+        m_Data = m_Elements.data();
+        m_Size = m_Elements.size();
+    }
+
+    /**
+     * views count elements stored at a byte offset into a mapped file, the offset must be aligned for T
+     */
+    DataBuffer(std::shared_ptr<const MappedFile> file, size_t offset, size_t count)
+        : m_File(std::move(file)), m_Size(count)
+    {
+        m_Data = reinterpret_cast<const T *>(m_File->getData() + offset);
+    }
+
+    DataBuffer(const DataBuffer &other) : m_Elements(other.m_Elements), m_File(other.m_File), m_Size(other.m_Size)
+    {
+        m_Data = m_File ? other.m_Data : m_Elements.data();
+    }
+
+    // moving a vector keeps its storage, so the data pointer stays valid
+    DataBuffer(DataBuffer &&other) noexcept
+        : m_Elements(std::move(other.m_Elements)), m_File(std::move(other.m_File)), m_Data(other.m_Data),
+          m_Size(other.m_Size)
+    {
+        other.m_Data = nullptr;
+        other.m_Size = 0;
+    }
+
+    auto operator=(DataBuffer other) noexcept -> DataBuffer &
+    {
+        m_Elements.swap(other.m_Elements);
+        m_File.swap(other.m_File);
+        std::swap(m_Data, other.m_Data);
+        std::swap(m_Size, other.m_Size);
+        return *this;
+    }
+
+    /**
+     * adds elements to the end of an owning buffer
+     */
+    void append(std::initializer_list<T> elements)
+    {
+        if (m_File)
+        {
+            throw std::logic_error("A mapped buffer can not be appended to!");
+        }
+
+        m_Elements.insert(m_Elements.end(), elements);
+        m_Data = m_Elements.data();
+        m_Size = m_Elements.size();
+    }
+
+    /**
+     * the elements for changing them in place, a view copies its elements first
+     */
+    auto mutableData() -> T *
+    {
+        if (m_File)
+        {
+            m_Elements.assign(m_Data, m_Data + m_Size);
+            m_File.reset();
+            m_Data = m_Elements.data();
+        }
+        return m_Elements.data();
+    }
+
+    /**
+     * true if the elements are read from a mapped file
+     */
+    auto inline isMapped() const -> bool
+    {
+        return m_File != nullptr;
+    }
+
+    auto inline data() const -> const T *
+    {
+        return m_Data;
+    }
+
+    auto inline size() const -> size_t
+    {
+        return m_Size;
+    }
+
+    auto inline empty() const -> bool
+    {
+        return m_Size == 0;
+    }
+
+    auto inline operator[](size_t index) const -> const T &
+    {
+        return m_Data[index];
+    }
+
+    auto inline begin() const -> const T *
+    {
+        return m_Data;
+    }
+
+    auto inline end() const -> const T *
+    {
+        return m_Data + m_Size;
+    }
+
+  private:
+    std::vector<T> m_Elements{};
+    std::shared_ptr<const MappedFile> m_File{};
+    const T *m_Data = nullptr;
+    size_t m_Size = 0;
+};
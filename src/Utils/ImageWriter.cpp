@@ -0,0 +1,86 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+/**
+ * writes the image in the format picked by the file extension
+ * .pfm keeps the full float radiance, .ppm is tone clamped to 8 bits
+ *
+ * \param filePath - the path of the image file to write
+ * \param pixels - width * height * 3 floats, rows ordered bottom to top
+ * \param width - the number of columns in the image
+ * \param height - the number of rows in the image
+ * \return - true if the image was written, false if there was an error
+ */
+auto ImageWriter::write(const std::string &filePath, const float *pixels, int width, int height) -> bool
+{
+    std::string extension = filePath.substr(filePath.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (extension == "pfm")
+    {
+        return writePFM(filePath, pixels, width, height);
+    }
+    else if (extension == "ppm")
+    {
+        return writePPM(filePath, pixels, width, height);
+    }
+
+    std::cerr << "Unsupported image format '." << extension << "', use .pfm or .ppm!" << std::endl;
+    return false;
+}
+
+/**
+ * writes a little endian portable float map
+ * pfm stores its rows bottom to top so the pixels are written as is
+ */
+auto ImageWriter::writePFM(const std::string &filePath, const float *pixels, int width, int height) -> bool
+{
+    std::ofstream imageFile(filePath, std::ios::out | std::ios::binary);
+    if (!imageFile)
+    {
+        std::cerr << "Could not open image file " << filePath << "!" << std::endl;
+        return false;
+    }
+
+    // a negative scale marks the data as little endian
+    imageFile << "PF\n" << width << " " << height << "\n-1.0\n";
+    imageFile.write(reinterpret_cast<const char *>(pixels),
+                    static_cast<std::streamsize>(sizeof(float) * 3 * width * height));
+
+    return imageFile.good();
+}
+
+/**
+ * writes a binary 8 bit portable pixmap
+ * colors are clamped to [0, 1] like the window displays them, rows are flipped to top to bottom
+ */
+auto ImageWriter::writePPM(const std::string &filePath, const float *pixels, int width, int height) -> bool
+{
+    std::ofstream imageFile(filePath, std::ios::out | std::ios::binary);
+    if (!imageFile)
+    {
+        std::cerr << "Could not open image file " << filePath << "!" << std::endl;
+        return false;
+    }
+
+    imageFile << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 3);
+    for (int y = height - 1; y >= 0; y--)
+    {
+        const float *src = pixels + static_cast<size_t>(y) * width * 3;
+        for (int i = 0; i < width * 3; i++)
+        {
+            row[i] = static_cast<uint8_t>(std::clamp(src[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+        imageFile.write(reinterpret_cast<const char *>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+
+    return imageFile.good();
+}
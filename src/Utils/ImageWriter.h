@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+
+/**
+ * writes a rendered RGB float image to disk
+ *
+ * pixel rows are expected bottom to top, the same layout the pixel buffer
+ * hands to glDrawPixels
+ */
+class ImageWriter
+{
+  public:
+    static auto write(const std::string &filePath, const float *pixels, int width, int height) -> bool;
+
+    static auto writePFM(const std::string &filePath, const float *pixels, int width, int height) -> bool;
+    static auto writePPM(const std::string &filePath, const float *pixels, int width, int height) -> bool;
+};
@@ -0,0 +1,118 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &filePath)
+{
+    m_File = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+    {
+        m_File = nullptr;
+        throw std::runtime_error("Could not open " + filePath + "!");
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_File, &size))
+    {
+        CloseHandle(m_File);
+        throw std::runtime_error("Could not read the size of " + filePath + "!");
+    }
+
+    m_Size = static_cast<size_t>(size.QuadPart);
+    if (m_Size == 0)
+    {
+        return;
+    }
+
+    m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping)
+    {
+        m_Data = static_cast<const char *>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+
+    if (!m_Data)
+    {
+        if (m_Mapping)
+        {
+            CloseHandle(m_Mapping);
+        }
+        CloseHandle(m_File);
+        throw std::runtime_error("Could not map " + filePath + " into memory!");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_Data)
+    {
+        UnmapViewOfFile(m_Data);
+        CloseHandle(m_Mapping);
+    }
+    if (m_File)
+    {
+        CloseHandle(m_File);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &filePath)
+{
+    m_File = open(filePath.c_str(), O_RDONLY);
+    if (m_File < 0)
+    {
+        throw std::runtime_error("Could not open " + filePath + "!");
+    }
+
+    struct stat fileStat = {};
+    if (fstat(m_File, &fileStat) != 0)
+    {
+        close(m_File);
+        throw std::runtime_error("Could not read the size of " + filePath + "!");
+    }
+
+    m_Size = static_cast<size_t>(fileStat.st_size);
+    if (m_Size == 0)
+    {
+        return;
+    }
+
+    void *data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+    if (data == MAP_FAILED)
+    {
+        close(m_File);
+        throw std::runtime_error("Could not map " + filePath + " into memory!");
+    }
+
+    // the whole file is about to be read, so the pages are asked for up front
+    madvise(data, m_Size, MADV_WILLNEED);
+    m_Data = static_cast<const char *>(data);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_Data)
+    {
+        munmap(const_cast<char *>(m_Data), m_Size);
+    }
+    if (m_File >= 0)
+    {
+        close(m_File);
+    }
+}
+
+#endif
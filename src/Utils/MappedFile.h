@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * a read only view of a whole file mapped into memory
+ *
+ * the pages are read in by the operating system as they are touched, so no copy of the file is made and threads
+ * can read different parts of it at the same time
+ */
+class MappedFile
+{
+  public:
+    /**
+     * maps a file, throws std::runtime_error if it can not be opened or mapped
+     */
+    explicit MappedFile(const std::string &filePath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+    /**
+     * the first byte of the file, null for an empty file
+     */
+    auto inline getData() const -> const char *
+    {
+        return m_Data;
+    }
+
+    auto inline getSize() const -> size_t
+    {
+        return m_Size;
+    }
+
+  private:
+    const char *m_Data = nullptr;
+    size_t m_Size = 0;
+
+#ifdef _WIN32
+    void *m_File = nullptr;
+    void *m_Mapping = nullptr;
+#else
+    int m_File = -1;
+#endif
+};
@@ -1,253 +1,437 @@
 #include "ObjModel.h"
 
-#include <cmath>
-#include <unistd.h>
-
-#include <exception>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+
+#include "Utils/MappedFile.h"
+#include "Utils/ThreadPool.h"
 
-ObjModel::ObjModel(std::string filePath) : material(Material("obj_material"))
+static auto isBlank(char c) -> bool
 {
-    loadModel(filePath);
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static auto skipBlanks(const char *cursor, const char *end) -> const char *
+{
+    while (cursor < end && isBlank(*cursor))
+    {
+        cursor++;
+    }
+    return cursor;
 }
 
 /**
- * loads an obj model as a list of triangles into the scene
- *
- * \param filePath - the file path to the model obj file
- * \return - true if the model was sucessfully loaded, false if there was an
- * error
+ * the end of the line that starts at cursor, not including the newline
  */
-auto ObjModel::loadModel(std::string filePath) -> bool
+static auto findLineEnd(const char *cursor, const char *end) -> const char *
 {
-    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-    std::vector<SceneObject> objList;
+    const void *newline = std::memchr(cursor, '\n', static_cast<size_t>(end - cursor));
+    return newline ? static_cast<const char *>(newline) : end;
+}
+
+/**
+ * the kind of data on a line, decided by its keyword
+ */
+enum class LineType
+{
+    Position,
+    Normal,
+    Face,
+    Other
+};
 
-    std::ifstream objFile(filePath.c_str(), std::ios::in);
-    int lineCount = 0;
-    if (objFile)
+static auto lineType(const char *cursor, const char *lineEnd) -> LineType
+{
+    size_t length = static_cast<size_t>(lineEnd - cursor);
+    if (length >= 2 && cursor[0] == 'v' && isBlank(cursor[1]))
+    {
+        return LineType::Position;
+    }
+    if (length >= 3 && cursor[0] == 'v' && cursor[1] == 'n' && isBlank(cursor[2]))
+    {
+        return LineType::Normal;
+    }
+    if (length >= 2 && cursor[0] == 'f' && isBlank(cursor[1]))
     {
-        std::string line;
+        return LineType::Face;
+    }
+    return LineType::Other;
+}
 
-        while (std::getline(objFile, line))
-        {
-            if (line.empty())
-            {
-                continue;
-            }
+/**
+ * parses the next float of a line and moves the cursor past it
+ */
+static auto parseFloat(const char *&cursor, const char *lineEnd, float &value) -> bool
+{
+    cursor = skipBlanks(cursor, lineEnd);
+    // from_chars does not accept an explicit plus sign
+    if (cursor < lineEnd && *cursor == '+')
+    {
+        cursor++;
+    }
 
-            std::vector<std::string> splitLine = splitString(line, std::string(" "));
+    auto result = std::from_chars(cursor, lineEnd, value);
+    if (result.ec != std::errc())
+    {
+        return false;
+    }
 
-            std::string lineType = splitLine[0];
-            splitLine.erase(splitLine.begin());
+    cursor = result.ptr;
+    return true;
+}
 
-            if (lineType == VERTEX_POS)
-            {
-                Vec3 vertex = parseVec3(splitLine);
-                m_vertexList.push_back(vertex);
-            }
-            else if (lineType == VERTEX_TEX)
-            {
-                std::cout << "Texture coord" << std::endl;
-            }
-            else if (lineType == VERTEX_NORM)
+static auto parseVec3(const char *&cursor, const char *lineEnd, Vec3 &vec) -> bool
+{
+    return parseFloat(cursor, lineEnd, vec.x) && parseFloat(cursor, lineEnd, vec.y) &&
+           parseFloat(cursor, lineEnd, vec.z);
+}
+
+/**
+ * parses one corner of a face and moves the cursor past it
+ *
+ * face vertex string format: "vertexIndex/textureCoord/vertexNormal", the texture coordinate and normal are
+ * optional and the normal is set to 0 if there is none
+ */
+static auto parseCorner(const char *&cursor, const char *lineEnd, long &position, long &normal) -> bool
+{
+    auto result = std::from_chars(cursor, lineEnd, position);
+    if (result.ec != std::errc())
+    {
+        return false;
+    }
+    cursor = result.ptr;
+    normal = 0;
+
+    if (cursor < lineEnd && *cursor == '/')
+    {
+        cursor++;
+
+        // texture coordinates are not used
+        if (cursor < lineEnd && *cursor != '/')
+        {
+            long texture = 0;
+            result = std::from_chars(cursor, lineEnd, texture);
+            if (result.ec != std::errc())
             {
-                Vec3 normal = parseVec3(splitLine);
-                m_normalList.push_back(normal);
+                return false;
             }
-            else if (lineType == FACE)
+            cursor = result.ptr;
+        }
+
+        if (cursor < lineEnd && *cursor == '/')
+        {
+            result = std::from_chars(cursor + 1, lineEnd, normal);
+            if (result.ec != std::errc())
             {
-                std::vector<FaceIndices> faceIndices = parseFace(splitLine);
-                m_faceIndicesList.push_back(faceIndices);
+                return false;
             }
+            cursor = result.ptr;
         }
-
-        objFile.close();
-
-        std::cout << "Model loaded sucessfully!" << std::endl;
-        return true;
-    }
-    else
-    {
-        std::cerr << "Model load failed!" << std::endl;
-        return false;
     }
+
+    return cursor == lineEnd || isBlank(*cursor);
 }
 
 /**
- * splits a string into a vector of substrings delimited by the delimiter
- * parameter
+ * turns a one based or negative relative .obj index into an index into a list
  *
- * \param inputString - the string to be split
- * \param delimiter - the string that splits the input string
+ * \param index - the index as written in the file
+ * \param numBefore - the number of elements defined before the line the index is on
+ * \param numTotal - the number of elements in the whole file
+ * \param resolved - set to the zero based index
+ * \return - false if the index is 0 or outside the list
  */
-auto ObjModel::splitString(std::string &inputString, std::string delimiter) -> std::vector<std::string>
+static auto resolveIndex(long index, uint32_t numBefore, uint32_t numTotal, uint32_t &resolved) -> bool
 {
-    std::vector<std::string> splitString;
-
-    size_t last = 0;
-    size_t next = 0;
-
-    std::string token;
-
-    while ((next = inputString.find(delimiter, last)) != std::string::npos)
+    long zeroBased = index > 0 ? index - 1 : static_cast<long>(numBefore) + index;
+    if (index == 0 || zeroBased < 0 || zeroBased >= static_cast<long>(numTotal))
     {
-        splitString.push_back(inputString.substr(last, next - last));
-        last = next + delimiter.length();
+        return false;
     }
 
-    splitString.push_back(inputString.substr(last, inputString.length()));
-
-    splitString.erase(
-        std::remove_if(splitString.begin(), splitString.end(), [](const std::string &s) { return s.empty(); }),
-        splitString.end());
-
-    return splitString;
+    resolved = static_cast<uint32_t>(zeroBased);
+    return true;
 }
 
 /**
- * creates a vector Vec3 from a vector of vectors of strings of size 3
- * the strings must be able to be converted into a float
- *
- * \param vertexData - the vector of strings to be converted into floats
- * \param vertices - the vector of Vec3 to add the newly created Vec3s to
+ * runs a task for every chunk, on the thread pool if there is more than one chunk
+ * an exception thrown by a task is stored as the error of its chunk
  */
-auto ObjModel::parseVec3(std::vector<std::string> &vertexData) -> Vec3
+void ObjModel::forEachChunk(std::vector<Chunk> &chunks, ThreadPool *threadPool,
+                            const std::function<void(Chunk &)> &task)
 {
-    if (vertexData.size() < 3)
+    auto runTask = [&task](Chunk &chunk) {
+        try
+        {
+            task(chunk);
+        }
+        catch (const std::exception &e)
+        {
+            chunk.error = e.what();
+        }
+    };
+
+    if (!threadPool || chunks.size() == 1)
     {
-        std::cout << "Vec3 size less than 3!" << std::endl;
+        for (Chunk &chunk : chunks)
+        {
+            runTask(chunk);
+        }
+        return;
     }
 
-    float x = std::stof(vertexData[0]);
-    float y = std::stof(vertexData[1]);
-    float z = std::stof(vertexData[2]);
+    for (Chunk &chunk : chunks)
+    {
+        threadPool->submit([&runTask, &chunk]() { runTask(chunk); });
+    }
+    threadPool->wait();
+}
 
-    return {x, y, z};
+ObjModel::ObjModel(std::string filePath, ThreadPool *threadPool) : material(Material("obj_material"))
+{
+    loadModel(filePath, threadPool);
 }
 
 /**
- * reads vector of vertices information and adds the necessary amount of
- * traingle to accurately describe the face
+ * loads an obj model as a list of triangles
  *
- * face vertex string format: "vertexIndex/textureCoord/vertexNormal"
+ * the file is split into chunks at line breaks, a first pass counts the positions and normals of every chunk so
+ * the second pass can parse all chunks at once and write the positions and normals straight into their place
  *
- * \param faceIndices - vector of vertex information as a string
+ * \param filePath - the file path to the model obj file
+ * \param threadPool - the threads the chunks are parsed on, the calling thread parses them alone if null
  */
-auto ObjModel::parseFace(std::vector<std::string> &faceIndices) -> std::vector<ObjModel::FaceIndices>
+void ObjModel::loadModel(const std::string &filePath, ThreadPool *threadPool)
 {
-    std::vector<FaceIndices> faces;
+    auto loadStart = std::chrono::steady_clock::now();
 
-    // iterate through all vertices of the face
-    for (std::string s : faceIndices)
-    {
-        // parse out vertex index, texture coord, & vertex normal
-        std::vector<std::string> faceIndexSplit = splitString(s, std::string("/"));
+    MappedFile file(filePath);
+    const char *data = file.getData();
+    const size_t size = file.getSize();
 
-        // face index
-        FaceIndices face;
+    size_t numChunks = 1;
+    if (threadPool)
+    {
+        // a few chunks per thread so a chunk full of faces does not hold up the others
+        size_t maxChunks = static_cast<size_t>(threadPool->getNumThreads()) * 4;
+        numChunks = std::max<size_t>(std::min(size / minChunkSize, maxChunks), 1);
+    }
 
-        // assign indices if available
-        for (int i = 0; i < faceIndexSplit.size(); i++)
+    std::vector<Chunk> chunks(numChunks);
+    const char *chunkBegin = data;
+    for (size_t i = 0; i < numChunks; i++)
+    {
+        // every chunk but the last ends after the first newline past its share of the file
+        const char *chunkEnd = data + size;
+        if (i + 1 < numChunks)
         {
-            if (!faceIndexSplit[i].empty())
-            {
-                unsigned int index = std::stoi(faceIndexSplit[i]);
-
-                switch (i)
-                {
-                case 0:
-                    face.position = index;
-                    face.positionSet = true;
-                    break;
-
-                case 1:
-                    face.texture = index;
-                    face.textureSet = true;
-                    break;
-
-                case 2:
-                    face.normal = index;
-                    face.normalSet = true;
-                    break;
-
-                default:
-                    std::cout << "Unexpected face index data!" << std::endl;
-                    exit(EXIT_FAILURE);
-                    break;
-                }
-            }
+            chunkEnd = std::max(chunkBegin, data + size * (i + 1) / numChunks);
+            chunkEnd = std::min(findLineEnd(chunkEnd, data + size) + 1, data + size);
         }
 
-        faces.push_back(face);
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
     }
 
-    return faces;
-}
+    forEachChunk(chunks, threadPool, countLines);
 
-auto ObjModel::createTriangleFromFaceIndices(FaceIndices fi0, FaceIndices fi1, FaceIndices fi2) -> Triangle
-{
-    bool positionsSet = fi0.positionSet && fi0.positionSet && fi2.positionSet;
-    bool normalsSet = fi0.normalSet && fi0.normalSet && fi2.normalSet;
-    bool textureSet = fi0.textureSet && fi0.textureSet && fi2.textureSet;
+    uint32_t numPositions = 0;
+    uint32_t numNormals = 0;
+    uint32_t numLines = 0;
+    for (Chunk &chunk : chunks)
+    {
+        chunk.positionOffset = numPositions;
+        chunk.normalOffset = numNormals;
+        chunk.lineOffset = numLines;
+        numPositions += chunk.numPositions;
+        numNormals += chunk.numNormals;
+        numLines += chunk.numLines;
+    }
 
-    Triangle tri;
+    m_vertexList.resize(numPositions);
+    m_normalList.resize(numNormals);
 
-    if (positionsSet && normalsSet)
+    forEachChunk(chunks, threadPool, [this](Chunk &chunk) { parseChunk(chunk); });
+
+    size_t numIndices = 0;
+    for (const Chunk &chunk : chunks)
     {
-        tri = Triangle(m_vertexList[fi0.position - 1], m_normalList[fi0.normal - 1], m_vertexList[fi1.position - 1],
-                       m_normalList[fi1.normal - 1], m_vertexList[fi2.position - 1], m_normalList[fi2.normal - 1]);
+        if (!chunk.error.empty())
+        {
+            throw std::runtime_error("Error loading " + filePath + ": " + chunk.error);
+        }
+        numIndices += chunk.positionIndices.size();
     }
-    else if (positionsSet)
+
+    m_positionIndexList.reserve(numIndices);
+    m_normalIndexList.reserve(numIndices);
+    for (Chunk &chunk : chunks)
     {
-        tri = Triangle(m_vertexList[fi0.position - 1], m_vertexList[fi1.position - 1], m_vertexList[fi2.position - 1]);
+        m_positionIndexList.insert(m_positionIndexList.end(), chunk.positionIndices.begin(),
+                                   chunk.positionIndices.end());
+        m_normalIndexList.insert(m_normalIndexList.end(), chunk.normalIndices.begin(), chunk.normalIndices.end());
     }
-    else
+
+    double loadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+    double megabytes = static_cast<double>(size) / (1024.0 * 1024.0);
+    std::cout << "Loaded " << filePath << ": " << numPositions << " vertices, " << numIndices / 3 << " triangles, "
+              << megabytes << " MB in " << loadTime * 1000.0 << " ms (" << megabytes / loadTime << " MB/s)"
+              << std::endl;
+}
+
+/**
+ * counts the lines of a chunk and the positions, normals and faces among them
+ */
+void ObjModel::countLines(Chunk &chunk)
+{
+    const char *cursor = chunk.begin;
+    while (cursor < chunk.end)
     {
-        throw std::runtime_error(std::string("Error creating triangle from obj mesh!"));
-    }
+        const char *lineEnd = findLineEnd(cursor, chunk.end);
+        switch (lineType(skipBlanks(cursor, lineEnd), lineEnd))
+        {
+        case LineType::Position:
+            chunk.numPositions++;
+            break;
+        case LineType::Normal:
+            chunk.numNormals++;
+            break;
+        case LineType::Face:
+            chunk.numFaces++;
+            break;
+        case LineType::Other:
+            break;
+        }
 
-    return tri;
+        chunk.numLines++;
+        cursor = lineEnd + 1;
+    }
 }
 
-auto ObjModel::getSceneObjects() -> std::vector<std::shared_ptr<SceneObject>>
+/**
+ * parses the positions, normals and faces of a chunk
+ * the positions and normals are written into the model's lists at the chunk's offsets and the triangles of the
+ * faces are kept in the chunk until all chunks are done
+ */
+void ObjModel::parseChunk(Chunk &chunk)
 {
-    std::vector<std::shared_ptr<SceneObject>> sceneObjectList;
+    const auto numTotalPositions = static_cast<uint32_t>(m_vertexList.size());
+    const auto numTotalNormals = static_cast<uint32_t>(m_normalList.size());
+
+    // most faces are triangles
+    chunk.positionIndices.reserve(3 * static_cast<size_t>(chunk.numFaces));
+    chunk.normalIndices.reserve(3 * static_cast<size_t>(chunk.numFaces));
+
+    uint32_t numPositions = chunk.positionOffset;
+    uint32_t numNormals = chunk.normalOffset;
+    uint32_t lineNumber = chunk.lineOffset;
+
+    auto fail = [&lineNumber](const char *message) {
+        throw std::runtime_error(std::string(message) + " on line " + std::to_string(lineNumber));
+    };
 
-    for (std::vector<ObjModel::FaceIndices> faceIndices : m_faceIndicesList)
+    const char *cursor = chunk.begin;
+    while (cursor < chunk.end)
     {
-        if (faceIndices.size() > 3)
+        lineNumber++;
+        const char *lineEnd = findLineEnd(cursor, chunk.end);
+        const char *lineStart = skipBlanks(cursor, lineEnd);
+        cursor = lineEnd + 1;
+
+        switch (lineType(lineStart, lineEnd))
         {
-            std::vector<Triangle> triList = triangulateFace(faceIndices);
-            for (Triangle tri : triList)
+        case LineType::Position: {
+            const char *values = lineStart + 1;
+            if (!parseVec3(values, lineEnd, m_vertexList[numPositions++]))
             {
-                sceneObjectList.push_back(std::make_shared<Triangle>(tri));
+                fail("Invalid vertex position");
             }
+            break;
         }
-        else
-        {
-            Triangle tri = createTriangleFromFaceIndices(faceIndices[0], faceIndices[1], faceIndices[2]);
 
-            sceneObjectList.push_back(std::make_shared<Triangle>(tri));
+        case LineType::Normal: {
+            const char *values = lineStart + 2;
+            if (!parseVec3(values, lineEnd, m_normalList[numNormals++]))
+            {
+                fail("Invalid vertex normal");
+            }
+            break;
         }
-    }
 
-    return sceneObjectList;
-}
+        case LineType::Face: {
+            // the first and previous corner of the fan the face is split into
+            uint32_t firstPosition = 0, firstNormal = 0, previousPosition = 0, previousNormal = 0;
+            unsigned int numCorners = 0;
 
-auto ObjModel::triangulateFace(std::vector<ObjModel::FaceIndices> faceIndices) -> std::vector<Triangle>
-{
-    FaceIndices start = faceIndices[0];
-    std::vector<Triangle> triList;
+            const char *corners = skipBlanks(lineStart + 1, lineEnd);
+            while (corners < lineEnd)
+            {
+                long position = 0;
+                long normal = 0;
+                if (!parseCorner(corners, lineEnd, position, normal))
+                {
+                    fail("Invalid face");
+                }
 
-    for (unsigned int i = 1; i < faceIndices.size() - 2; i++)
-    {
-        Triangle tri = createTriangleFromFaceIndices(start, faceIndices[i], faceIndices[i + 1]);
+                uint32_t positionIndex = 0;
+                uint32_t normalIndex = TriangleMesh::flatNormal;
+                if (!resolveIndex(position, numPositions, numTotalPositions, positionIndex) ||
+                    (normal != 0 && !resolveIndex(normal, numNormals, numTotalNormals, normalIndex)))
+                {
+                    fail("Face index out of range");
+                }
 
-        triList.emplace_back(tri);
+                if (numCorners == 0)
+                {
+                    firstPosition = positionIndex;
+                    firstNormal = normalIndex;
+                }
+                else if (numCorners >= 2)
+                {
+                    // push_back is cheaper than inserting a list of three
+                    chunk.positionIndices.push_back(firstPosition);
+                    chunk.positionIndices.push_back(previousPosition);
+                    chunk.positionIndices.push_back(positionIndex);
+
+                    // the normal is only interpolated if all three corners have one
+                    bool flat = firstNormal == TriangleMesh::flatNormal ||
+                                previousNormal == TriangleMesh::flatNormal || normalIndex == TriangleMesh::flatNormal;
+                    chunk.normalIndices.push_back(flat ? TriangleMesh::flatNormal : firstNormal);
+                    chunk.normalIndices.push_back(flat ? TriangleMesh::flatNormal : previousNormal);
+                    chunk.normalIndices.push_back(flat ? TriangleMesh::flatNormal : normalIndex);
+                }
+
+                previousPosition = positionIndex;
+                previousNormal = normalIndex;
+                numCorners++;
+                corners = skipBlanks(corners, lineEnd);
+            }
+            break;
+        }
+
+        case LineType::Other:
+            break;
+        }
     }
+}
+
+/**
+ * \return - the mesh of the model as its only scene object
+ */
+auto ObjModel::getSceneObjects() -> std::vector<std::shared_ptr<SceneObject>>
+{
+    return {getMesh()};
+}
 
-    return triList;
+auto ObjModel::getMesh() -> std::shared_ptr<TriangleMesh>
+{
+    return std::make_shared<TriangleMesh>(m_vertexList, m_normalList, m_positionIndexList, m_normalIndexList);
 }
 
 auto ObjModel::getCenterPoint() -> Vec3
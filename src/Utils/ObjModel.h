@@ -1,62 +1,84 @@
 #pragma once
-#include <fstream>
-#include <iostream>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "Scene/Material.h"
-#include "Scene/Scene.h"
 #include "Scene/SceneObject.h"
 #include "Utils/Vec3.h"
 
+class ThreadPool;
+
+/**
+ * a triangle mesh loaded from a wavefront .obj file
+ *
+ * the file is mapped into memory and split into chunks of whole lines that are parsed in parallel without
+ * allocating per line, only positions, normals and faces are read, every other line type is skipped
+ */
 class ObjModel
 {
   private:
-    // .obj keywords and line types
-    const std::string VERTEX_POS = "v";
-    const std::string VERTEX_TEX = "vt";
-    const std::string VERTEX_NORM = "vn";
-    const std::string VERTEX_PARAM = "vp";
-    const std::string FACE = "f";
-    const std::string LINE = "l";
-    const std::string OBJECT = "o";
-    const std::string GROUP = "g";
-    const std::string MATERIAL = "mtllib";
-    const std::string USE_MATERIAL = "usemtl";
-    const std::string NEW_MATERIAL = "newmtl";
-
     std::vector<Vec3> m_vertexList{};
     std::vector<Vec3> m_normalList{};
     Material material{"default_obj_material_name"};
 
-    struct FaceIndices
+    // three indices per triangle, faces with more than three vertices are split into a fan of triangles around
+    // their first vertex while parsing
+    std::vector<uint32_t> m_positionIndexList{};
+    std::vector<uint32_t> m_normalIndexList{};
+
+    /**
+     * a range of whole lines of the file that is parsed by one task
+     */
+    struct Chunk
     {
-        unsigned int position{};
-        bool positionSet = false;
+        const char *begin = nullptr;
+        const char *end = nullptr;
+
+        // counted by the first pass over the chunk
+        uint32_t numPositions = 0;
+        uint32_t numNormals = 0;
+        uint32_t numFaces = 0;
+        uint32_t numLines = 0;
 
-        unsigned int texture{};
-        bool textureSet = false;
+        // the number of positions, normals and lines in all chunks before this one, so relative indices and the
+        // positions and normals parsed by this chunk can be placed without waiting for the other chunks
+        uint32_t positionOffset = 0;
+        uint32_t normalOffset = 0;
+        uint32_t lineOffset = 0;
 
-        unsigned int normal{};
-        bool normalSet = false;
+        std::vector<uint32_t> positionIndices{};
+        std::vector<uint32_t> normalIndices{};
+
+        // set instead of throwing on the worker thread, the first error of all chunks is thrown after the parse
+        std::string error{};
     };
-    std::vector<std::vector<FaceIndices>> m_faceIndicesList{};
 
   public:
-    ObjModel(std::string filePath);
+    ObjModel(std::string filePath, ThreadPool *threadPool = nullptr);
     std::vector<std::shared_ptr<SceneObject>> getSceneObjects();
+
+    /**
+     * creates one triangle mesh from all faces of the model
+     */
+    auto getMesh() -> std::shared_ptr<TriangleMesh>;
     inline std::vector<Vec3> getVertexList()
     {
         return m_vertexList;
     };
     auto getCenterPoint() -> Vec3;
 
+    /**
+     * the smallest chunk the file is split into, smaller files are parsed by the calling thread alone
+     */
+    static constexpr size_t minChunkSize = 1U << 18;
+
   private:
-    auto loadModel(std::string filePath) -> bool;
-    std::vector<std::string> splitString(std::string &inputString, std::string delimiter);
-    auto parseVec3(std::vector<std::string> &vertexData) -> Vec3;
-    std::vector<FaceIndices> parseFace(std::vector<std::string> &faceIndices);
-    std::vector<Triangle> triangulateFace(std::vector<ObjModel::FaceIndices> faceIndices);
-    Triangle createTriangleFromFaceIndices(FaceIndices fi0, FaceIndices fi1, FaceIndices fi2);
+    void loadModel(const std::string &filePath, ThreadPool *threadPool);
+    static void forEachChunk(std::vector<Chunk> &chunks, ThreadPool *threadPool,
+                             const std::function<void(Chunk &)> &task);
+    static void countLines(Chunk &chunk);
+    void parseChunk(Chunk &chunk);
 };
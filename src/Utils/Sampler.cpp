@@ -0,0 +1,294 @@
+#include "Sampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * the PCG output permutation used as an integer hash (Jarzynski & Olano, "Hash Functions for GPU Rendering")
+ */
+static auto pcgHash(uint32_t v) -> uint32_t
+{
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+static auto hashCombine(uint32_t seed, uint32_t v) -> uint32_t
+{
+    return pcgHash(seed ^ pcgHash(v));
+}
+
+/**
+ * maps 32 random bits to a float in [0, 1), the upper 24 bits fill the float mantissa exactly
+ */
+static auto toUnitFloat(uint32_t bits) -> float
+{
+    return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+static auto reverseBits(uint32_t v) -> uint32_t
+{
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+/**
+ * the first two dimensions of the Sobol sequence, which together are a (0, 2) sequence so every power of two
+ * prefix is stratified in all elementary intervals
+ *
+ * the first dimension is the van der Corput sequence, the second multiplies the bits of the index with the
+ * generator matrix of the dimension, stored as the xor of the matrix columns for every byte value of every byte
+ */
+struct SobolTables
+{
+    uint32_t byteColumns[4][256];
+
+    SobolTables()
+    {
+        uint32_t columns[32];
+        columns[0] = 1u << 31;
+        for (unsigned int bit = 1; bit < 32; bit++)
+        {
+            columns[bit] = columns[bit - 1] ^ (columns[bit - 1] >> 1);
+        }
+
+        for (unsigned int byte = 0; byte < 4; byte++)
+        {
+            for (uint32_t value = 0; value < 256; value++)
+            {
+                uint32_t sum = 0;
+                for (unsigned int bit = 0; bit < 8; bit++)
+                {
+                    if ((value >> bit) & 1u)
+                    {
+                        sum ^= columns[byte * 8 + bit];
+                    }
+                }
+                byteColumns[byte][value] = sum;
+            }
+        }
+    }
+};
+
+static const SobolTables sobolTables;
+
+static auto sobol(uint32_t index, uint32_t dim) -> uint32_t
+{
+    if (dim == 0)
+    {
+        return reverseBits(index);
+    }
+
+    return sobolTables.byteColumns[0][index & 0xffu] ^ sobolTables.byteColumns[1][(index >> 8) & 0xffu] ^
+           sobolTables.byteColumns[2][(index >> 16) & 0xffu] ^ sobolTables.byteColumns[3][index >> 24];
+}
+
+/**
+ * a random permutation of the bits below each bit, the same as Owen scrambling a base 2 digit expansion
+ * (Burley, "Practical Hash-based Owen Scrambling")
+ */
+static auto nestedUniformScramble(uint32_t v, uint32_t seed) -> uint32_t
+{
+    v = reverseBits(v);
+    v += seed;
+    v ^= v * 0x6c50b47cu;
+    v ^= v * 0xb82f1e52u;
+    v ^= v * 0xc7afe638u;
+    v ^= v * 0x8d22f6e6u;
+    return reverseBits(v);
+}
+
+/**
+ * one dimension of a shuffled and scrambled two dimensional Sobol sequence, every pair of dimensions uses its own seed
+ * to shuffle the order of the points so the pairs are independent of each other
+ */
+static auto scrambledSobol(uint32_t sampleIndex, uint32_t dimension, uint32_t seed) -> uint32_t
+{
+    uint32_t pairSeed = hashCombine(seed, dimension >> 1);
+    uint32_t index = nestedUniformScramble(sampleIndex, pairSeed);
+    return nestedUniformScramble(sobol(index, dimension & 1u), hashCombine(pairSeed, dimension & 1u));
+}
+
+/**
+ * both dimensions of one pair of scrambledSobol, the shuffled index is shared
+ */
+static void scrambledSobol2D(uint32_t sampleIndex, uint32_t pair, uint32_t seed, uint32_t &v1, uint32_t &v2)
+{
+    uint32_t pairSeed = hashCombine(seed, pair);
+    uint32_t index = nestedUniformScramble(sampleIndex, pairSeed);
+    v1 = nestedUniformScramble(sobol(index, 0), hashCombine(pairSeed, 0));
+    v2 = nestedUniformScramble(sobol(index, 1), hashCombine(pairSeed, 1));
+}
+
+static auto pixelSeed(uint32_t pixelX, uint32_t pixelY) -> uint32_t
+{
+    return hashCombine(pcgHash(pixelX), pixelY);
+}
+
+auto Sampler::create(SamplerType type) -> std::unique_ptr<Sampler>
+{
+    switch (type)
+    {
+    case SamplerType::Sobol:
+        return std::make_unique<SobolSampler>();
+    case SamplerType::BlueNoise:
+        return std::make_unique<BlueNoiseSampler>();
+    default:
+        return std::make_unique<RandomSampler>();
+    }
+}
+
+auto RandomSampler::get(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t dimension) const -> float
+{
+    return toUnitFloat(hashCombine(hashCombine(pixelSeed(pixelX, pixelY), sampleIndex), dimension));
+}
+
+void RandomSampler::get2D(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t pair, float &u1,
+                          float &u2) const
+{
+    uint32_t key = hashCombine(pixelSeed(pixelX, pixelY), sampleIndex);
+    u1 = toUnitFloat(hashCombine(key, 2 * pair));
+    u2 = toUnitFloat(hashCombine(key, 2 * pair + 1));
+}
+
+auto SobolSampler::get(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t dimension) const -> float
+{
+    return toUnitFloat(scrambledSobol(sampleIndex, dimension, pixelSeed(pixelX, pixelY)));
+}
+
+void SobolSampler::get2D(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t pair, float &u1,
+                         float &u2) const
+{
+    uint32_t v1, v2;
+    scrambledSobol2D(sampleIndex, pair, pixelSeed(pixelX, pixelY), v1, v2);
+    u1 = toUnitFloat(v1);
+    u2 = toUnitFloat(v2);
+}
+
+BlueNoiseSampler::BlueNoiseSampler()
+{
+    const uint32_t size = textureSize;
+    const uint32_t numPixels = size * size;
+    const float sigma = 1.5f;
+
+    // the energy a point adds to the pixels around it, indexed by the wrapped offset between them
+    std::vector<float> kernel(numPixels);
+    for (uint32_t dy = 0; dy < size; dy++)
+    {
+        for (uint32_t dx = 0; dx < size; dx++)
+        {
+            float x = static_cast<float>(std::min(dx, size - dx));
+            float y = static_cast<float>(std::min(dy, size - dy));
+            kernel[dy * size + dx] = expf(-(x * x + y * y) / (2.0f * sigma * sigma));
+        }
+    }
+
+    std::vector<bool> points(numPixels, false);
+    std::vector<float> energy(numPixels, 0.0f);
+    auto setPoint = [&](uint32_t p, bool set) {
+        points[p] = set;
+        float sign = set ? 1.0f : -1.0f;
+        uint32_t px = p % size, py = p / size;
+        for (uint32_t q = 0; q < numPixels; q++)
+        {
+            uint32_t dx = (q % size - px) & (size - 1);
+            uint32_t dy = (q / size - py) & (size - 1);
+            energy[q] += sign * kernel[dy * size + dx];
+        }
+    };
+
+    // the point in the tightest cluster or the empty pixel in the largest void
+    auto extreme = [&](bool ofPoints) {
+        uint32_t best = 0;
+        float bestEnergy = ofPoints ? -INFINITY : INFINITY;
+        for (uint32_t p = 0; p < numPixels; p++)
+        {
+            if (points[p] == ofPoints && (ofPoints ? energy[p] > bestEnergy : energy[p] < bestEnergy))
+            {
+                best = p;
+                bestEnergy = energy[p];
+            }
+        }
+        return best;
+    };
+
+    // a random initial pattern is relaxed by moving points from clusters into voids until that changes nothing
+    uint32_t numInitial = numPixels / 10;
+    for (uint32_t i = 0, p = 0; p < numInitial; i++)
+    {
+        uint32_t pixel = pcgHash(i) % numPixels;
+        if (!points[pixel])
+        {
+            setPoint(pixel, true);
+            p++;
+        }
+    }
+
+    while (true)
+    {
+        uint32_t cluster = extreme(true);
+        setPoint(cluster, false);
+        uint32_t largestVoid = extreme(false);
+        setPoint(largestVoid, true);
+        if (largestVoid == cluster)
+        {
+            break;
+        }
+    }
+
+    std::vector<bool> initialPoints = points;
+    std::vector<float> initialEnergy = energy;
+    std::vector<uint32_t> rank(numPixels);
+
+    // the initial points are ranked by removing them from the tightest clusters first
+    for (uint32_t numPoints = numInitial; numPoints > 0; numPoints--)
+    {
+        uint32_t cluster = extreme(true);
+        setPoint(cluster, false);
+        rank[cluster] = numPoints - 1;
+    }
+
+    // the remaining pixels are ranked by filling the largest voids first
+    points = initialPoints;
+    energy = initialEnergy;
+    for (uint32_t numPoints = numInitial; numPoints < numPixels; numPoints++)
+    {
+        uint32_t largestVoid = extreme(false);
+        setPoint(largestVoid, true);
+        rank[largestVoid] = numPoints;
+    }
+
+    m_Texture.resize(numPixels);
+    for (uint32_t p = 0; p < numPixels; p++)
+    {
+        m_Texture[p] = (static_cast<float>(rank[p]) + 0.5f) / static_cast<float>(numPixels);
+    }
+}
+
+auto BlueNoiseSampler::get(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t dimension) const -> float
+{
+    return rotate(scrambledSobol(sampleIndex, dimension, 0), pixelX, pixelY, dimension);
+}
+
+void BlueNoiseSampler::get2D(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t pair, float &u1,
+                             float &u2) const
+{
+    uint32_t v1, v2;
+    scrambledSobol2D(sampleIndex, pair, 0, v1, v2);
+    u1 = rotate(v1, pixelX, pixelY, 2 * pair);
+    u2 = rotate(v2, pixelX, pixelY, 2 * pair + 1);
+}
+
+auto BlueNoiseSampler::rotate(uint32_t bits, uint32_t pixelX, uint32_t pixelY, uint32_t dimension) const -> float
+{
+    // every dimension reads the texture at its own offset so the rotations of different dimensions are unrelated
+    uint32_t offset = pcgHash(dimension);
+    uint32_t x = (pixelX + offset) & (textureSize - 1);
+    uint32_t y = (pixelY + (offset >> 16)) & (textureSize - 1);
+
+    float value = toUnitFloat(bits) + m_Texture[y * textureSize + x];
+    return value < 1.0f ? value : value - 1.0f;
+}
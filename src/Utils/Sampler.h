@@ -0,0 +1,141 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * the sequences a sampler can draw its numbers from
+ */
+enum class SamplerType
+{
+    // independent hashed random numbers
+    Random,
+
+    // Owen scrambled Sobol points, every pixel is scrambled with its own seed
+    Sobol,
+
+    // one Owen scrambled Sobol sequence for all pixels, rotated per pixel by a blue noise texture so the error of
+    // neighbouring pixels is spread into high frequencies
+    BlueNoise
+};
+
+/**
+ * the source of the numbers in [0, 1) a sample uses to pick its pixel position, points on lights and bounce directions
+ *
+ * every number is addressed by the pixel, the index of the sample in the pixel and a dimension, so any thread can draw
+ * any sample's numbers without shared state and the same sample always gets the same numbers
+ */
+class Sampler
+{
+  public:
+    virtual ~Sampler() = default;
+
+    /**
+     * returns one number of one sample
+     *
+     * \param pixelX, pixelY - the pixel of the sample
+     * \param sampleIndex - the index of the sample in the pixel
+     * \param dimension - which of the sample's numbers to return, the numbers of the dimensions 2k and 2k + 1 are
+     *                    stratified together
+     */
+    virtual auto get(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t dimension) const -> float = 0;
+
+    /**
+     * returns the numbers of the pair of dimensions 2k and 2k + 1 with one call
+     *
+     * \param pair - the index k of the pair
+     */
+    virtual void get2D(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t pair, float &u1,
+                       float &u2) const = 0;
+
+    static auto create(SamplerType type) -> std::unique_ptr<Sampler>;
+};
+
+class RandomSampler : public Sampler
+{
+  public:
+    auto get(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t dimension) const -> float override;
+    void get2D(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t pair, float &u1,
+               float &u2) const override;
+};
+
+class SobolSampler : public Sampler
+{
+  public:
+    auto get(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t dimension) const -> float override;
+    void get2D(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t pair, float &u1,
+               float &u2) const override;
+};
+
+class BlueNoiseSampler : public Sampler
+{
+  public:
+    /**
+     * creates the blue noise texture with the void and cluster method (Ulichney, "The void-and-cluster method for
+     * dither array generation")
+     */
+    BlueNoiseSampler();
+
+    auto get(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t dimension) const -> float override;
+    void get2D(uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex, uint32_t pair, float &u1,
+               float &u2) const override;
+
+    static constexpr uint32_t textureSize = 64;
+
+  private:
+    /**
+     * shifts a sequence value by the texture value of the pixel, wrapping around at 1
+     */
+    auto rotate(uint32_t bits, uint32_t pixelX, uint32_t pixelY, uint32_t dimension) const -> float;
+
+    std::vector<float> m_Texture;
+};
+
+/**
+ * the numbers of one sample drawn in order, the way a sample's path uses them
+ *
+ * the camera ray and every bounce get their own range of dimensions, so how many numbers one bounce draws does not
+ * change the numbers of the next
+ */
+class SampleStream
+{
+  public:
+    SampleStream(const Sampler &sampler, uint32_t pixelX, uint32_t pixelY, uint32_t sampleIndex)
+        : m_Sampler(&sampler), m_PixelX(pixelX), m_PixelY(pixelY), m_SampleIndex(sampleIndex)
+    {
+    }
+
+    /**
+     * returns a stream with its own dimensions for a bounce of the sample's path
+     * the dimensions of the stream created from the pixel and sample are reserved for the camera ray
+     *
+     * \param bounce - the number of bounces of the path
+     */
+    auto inline forBounce(uint32_t bounce) const -> SampleStream
+    {
+        SampleStream stream = *this;
+        stream.m_Dimension = (bounce + 1) << 16;
+        return stream;
+    }
+
+    auto inline nextFloat() -> float
+    {
+        return m_Sampler->get(m_PixelX, m_PixelY, m_SampleIndex, m_Dimension++);
+    }
+
+    /**
+     * returns two numbers of the same stratified pair of dimensions
+     */
+    inline void next2D(float &u1, float &u2)
+    {
+        uint32_t pair = (m_Dimension + 1) >> 1;
+        m_Sampler->get2D(m_PixelX, m_PixelY, m_SampleIndex, pair, u1, u2);
+        m_Dimension = 2 * pair + 2;
+    }
+
+  private:
+    const Sampler *m_Sampler;
+    uint32_t m_PixelX, m_PixelY;
+    uint32_t m_SampleIndex;
+    uint32_t m_Dimension = 0;
+};
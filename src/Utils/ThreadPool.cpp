@@ -0,0 +1,89 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+/**
+ * starts the worker threads, they sleep until a task is submitted
+ *
+ * \param numThreads - the number of worker threads, at least one is created
+ */
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+    numThreads = std::max(numThreads, 1U);
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        m_Workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+/**
+ * finishes the queued tasks and joins the worker threads
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_TaskAvailable.notify_all();
+
+    for (std::thread &worker : m_Workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * queues a task to be run by the next free worker thread
+ *
+ * \param task - the function to run
+ */
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.push_back(std::move(task));
+    }
+    m_TaskAvailable.notify_one();
+}
+
+/**
+ * blocks until every submitted task has finished running
+ */
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_AllTasksDone.wait(lock, [this]() { return m_Tasks.empty() && m_NumBusy == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_TaskAvailable.wait(lock, [this]() { return m_Stop || !m_Tasks.empty(); });
+
+            if (m_Tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+            m_NumBusy++;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_NumBusy--;
+            if (m_Tasks.empty() && m_NumBusy == 0)
+            {
+                m_AllTasksDone.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * a fixed set of long lived worker threads that run submitted tasks
+ *
+ * the threads are created once and reused so no thread is created or joined
+ * while rendering
+ */
+class ThreadPool
+{
+  public:
+    ThreadPool(unsigned int numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    auto operator=(const ThreadPool &) -> ThreadPool & = delete;
+
+    void submit(std::function<void()> task);
+    void wait();
+
+    auto inline getNumThreads() const -> unsigned int
+    {
+        return static_cast<unsigned int>(m_Workers.size());
+    }
+
+  private:
+    void workerLoop();
+
+    std::vector<std::thread> m_Workers{};
+    std::deque<std::function<void()>> m_Tasks{};
+
+    std::mutex m_Mutex;
+    std::condition_variable m_TaskAvailable;
+    std::condition_variable m_AllTasksDone;
+
+    unsigned int m_NumBusy = 0;
+    bool m_Stop = false;
+};
@@ -0,0 +1,131 @@
+#pragma once
+#include <cmath>
+
+#include "Vec3.h"
+
+/**
+ * an affine transform stored as the rows of a 3x4 matrix, a 3x3 linear part followed by a translation column
+ *
+ * points are transformed with the translation and directions without it
+ */
+struct Transform
+{
+    float m[3][4] = {{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}};
+
+    static auto translation(const Vec3 &offset) -> Transform
+    {
+        Transform t;
+        t.m[0][3] = offset.x;
+        t.m[1][3] = offset.y;
+        t.m[2][3] = offset.z;
+        return t;
+    }
+
+    static auto scaling(const Vec3 &scale) -> Transform
+    {
+        Transform t;
+        t.m[0][0] = scale.x;
+        t.m[1][1] = scale.y;
+        t.m[2][2] = scale.z;
+        return t;
+    }
+
+    /**
+     * a counter clockwise rotation about the x (0), y (1) or z (2) axis
+     */
+    static auto rotation(int axis, float degrees) -> Transform
+    {
+        float radians = degrees * PI / 180.0f;
+        float c = cosf(radians);
+        float s = sinf(radians);
+
+        // the two axes the rotation turns into each other
+        int a = (axis + 1) % 3;
+        int b = (axis + 2) % 3;
+
+        Transform t;
+        t.m[a][a] = c;
+        t.m[a][b] = -s;
+        t.m[b][a] = s;
+        t.m[b][b] = c;
+        return t;
+    }
+
+    /**
+     * the transform that applies other first and this second
+     */
+    auto operator*(const Transform &other) const -> Transform
+    {
+        Transform t;
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 4; col++)
+            {
+                float sum = col == 3 ? m[row][3] : 0.0f;
+                for (int k = 0; k < 3; k++)
+                {
+                    sum += m[row][k] * other.m[k][col];
+                }
+                t.m[row][col] = sum;
+            }
+        }
+        return t;
+    }
+
+    /**
+     * the inverse transform, the linear part must not be singular
+     */
+    auto inverse() const -> Transform
+    {
+        // the inverse of the linear part is its adjugate divided by its determinant
+        float cofactor[3][3];
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                int r0 = (row + 1) % 3, r1 = (row + 2) % 3;
+                int c0 = (col + 1) % 3, c1 = (col + 2) % 3;
+                cofactor[row][col] = m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0];
+            }
+        }
+        float determinant = m[0][0] * cofactor[0][0] + m[0][1] * cofactor[0][1] + m[0][2] * cofactor[0][2];
+
+        Transform t;
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                t.m[row][col] = cofactor[col][row] / determinant;
+            }
+        }
+
+        // the translation is undone after the linear part is
+        for (int row = 0; row < 3; row++)
+        {
+            t.m[row][3] = -(t.m[row][0] * m[0][3] + t.m[row][1] * m[1][3] + t.m[row][2] * m[2][3]);
+        }
+        return t;
+    }
+
+    auto inline applyPoint(const Vec3 &p) const -> Vec3
+    {
+        return {m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]};
+    }
+
+    auto inline applyVector(const Vec3 &v) const -> Vec3
+    {
+        return {m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z, m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z};
+    }
+
+    /**
+     * applies the transposed linear part, a normal is moved by the transposed inverse of the transform of its surface
+     */
+    auto inline applyTransposed(const Vec3 &v) const -> Vec3
+    {
+        return {m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z, m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+                m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z};
+    }
+};
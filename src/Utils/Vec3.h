@@ -5,6 +5,9 @@
 #include <vector>
 using json = nlohmann::json;
 
+// M_PI is not defined by every compiler's cmath
+constexpr float PI = 3.14159265358979f;
+
 /**
  * vector of size three to describe a position or direction in 3D space
  */
@@ -41,7 +44,7 @@ struct Vec3
     }
 
     // ADD
-    inline auto operator+(const Vec3 &vec) -> Vec3
+    inline auto operator+(const Vec3 &vec) const -> Vec3
     {
         return {x + vec.x, y + vec.y, z + vec.z};
     }
@@ -52,7 +55,7 @@ struct Vec3
     }
 
     // SUBTRACT
-    inline auto operator-(const Vec3 &vec) -> Vec3
+    inline auto operator-(const Vec3 &vec) const -> Vec3
     {
         return {x - vec.x, y - vec.y, z - vec.z};
     }
@@ -63,7 +66,7 @@ struct Vec3
     }
 
     // MULTIPLY
-    inline auto operator*(const Vec3 &vec) -> Vec3
+    inline auto operator*(const Vec3 &vec) const -> Vec3
     {
         return {x * vec.x, y * vec.y, z * vec.z};
     }
@@ -74,13 +77,13 @@ struct Vec3
     }
 
     // SCALE
-    inline auto operator*(float s) -> Vec3
+    inline auto operator*(float s) const -> Vec3
     {
         return {x * s, y * s, z * s};
     }
 
     // DIVIDE
-    inline auto operator/(const Vec3 &vec) -> Vec3
+    inline auto operator/(const Vec3 &vec) const -> Vec3
     {
         return {x / vec.x, y / vec.y, z / vec.z};
     }
@@ -93,19 +96,19 @@ struct Vec3
     }
 
     // DOT PRODUCT
-    inline auto dot(const Vec3 &vec) -> float
+    inline auto dot(const Vec3 &vec) const -> float
     {
         return (x * vec.x) + (y * vec.y) + (z * vec.z);
     }
 
     // CROSS PRODUCT
-    inline auto cross(const Vec3 &vec) -> Vec3
+    inline auto cross(const Vec3 &vec) const -> Vec3
     {
         return {y * vec.z - z * vec.y, z * vec.x - x * vec.z, x * vec.y - y * vec.x};
     }
 
     // LENGTH
-    inline auto length() -> float
+    inline auto length() const -> float
     {
         return sqrtf((x * x) + (y * y) + (z * z));
     }
@@ -125,3 +128,17 @@ struct Vec3
         return os;
     }
 };
+
+/**
+ * turns a direction given relative to a unit axis into world space, the axis is the z axis of the direction
+ * (Duff et al., "Building an Orthonormal Basis, Revisited")
+ */
+inline auto toWorld(const Vec3 &axis, float x, float y, float z) -> Vec3
+{
+    float sign = std::copysign(1.0f, axis.z);
+    float a = -1.0f / (sign + axis.z);
+    float b = axis.x * axis.y * a;
+    Vec3 tangent(1.0f + sign * axis.x * axis.x * a, sign * b, -sign * axis.x);
+    Vec3 bitangent(b, sign + axis.y * axis.y * a, -axis.y);
+    return tangent * x + bitangent * y + axis * z;
+}
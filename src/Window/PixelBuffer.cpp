@@ -1,6 +1,6 @@
 #include "PixelBuffer.h"
-#include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <iostream>
 
 /**
@@ -13,6 +13,7 @@ PixelBuffer::PixelBuffer(int width, int height)
     : m_Width(width), m_Height(height), m_Buffer(new float[m_Width * m_Height * 3]),
       m_MetaDataBuffer(new PixelMetaData[m_Width * m_Height])
 {
+    clearBuffer();
 }
 
 /**
@@ -26,31 +27,23 @@ PixelBuffer::~PixelBuffer()
 
 /**
  * sets the color of a single pixel in the buffer
- * if a pixel is set/colored multiple times the colors are averaged
+ * the color is the already averaged result of all samples taken in the pixel
  *
  * \param x - the width of the pixel to be colored
  * \param y - the height of the pixel to be colored
  * \param color - the color as a Vec3 to set the desired pixel
+ * \param numRaysShot - the number of samples averaged into the color
  */
-void PixelBuffer::setPixel(int x, int y, Vec3 color)
+void PixelBuffer::setPixel(int x, int y, Vec3 color, unsigned int numRaysShot)
 {
     unsigned int metaDataIndex = (y * m_Width + x);
     unsigned int index = metaDataIndex * 3;
-    Vec3 oldColor = Vec3(m_Buffer[index], m_Buffer[index + 1], m_Buffer[index + 2]);
-
-    unsigned int numRaysShot = m_MetaDataBuffer[metaDataIndex].numRaysShot;
-    unsigned int newNumRaysShot = numRaysShot + 1;
-
-    float oldProportion = (float)numRaysShot / (float)(numRaysShot + 1.0f);
-    float newProportion = 1.0f / (float)(numRaysShot + 1.0f);
 
-    Vec3 newColor = (oldColor * oldProportion) + (color * newProportion);
+    m_Buffer[index] = color.x;
+    m_Buffer[index + 1] = color.y;
+    m_Buffer[index + 2] = color.z;
 
-    m_Buffer[index] = newColor.x;
-    m_Buffer[index + 1] = newColor.y;
-    m_Buffer[index + 2] = newColor.z;
-
-    m_MetaDataBuffer[metaDataIndex].numRaysShot++;
+    m_MetaDataBuffer[metaDataIndex].numRaysShot = numRaysShot;
 }
 
 /**
@@ -80,15 +73,18 @@ void PixelBuffer::resizeBuffer(int width, int height)
     m_Buffer = new float[size];
 
     delete[] m_MetaDataBuffer;
-    m_MetaDataBuffer = new PixelMetaData[size];
+    m_MetaDataBuffer = new PixelMetaData[m_Width * m_Height];
 
     clearBuffer();
 }
 
+/**
+ * resets every pixel to black and every pixel's sample count to zero
+ */
 void PixelBuffer::clearBuffer()
 {
-    std::fill(m_Buffer, m_Buffer + sizeof(m_Buffer), 0);
-    glDrawPixels(m_Width, m_Height, GL_RGB, GL_FLOAT, m_Buffer);
+    std::fill(m_Buffer, m_Buffer + (m_Width * m_Height * 3), 0.0f);
+    std::fill(m_MetaDataBuffer, m_MetaDataBuffer + (m_Width * m_Height), PixelMetaData{});
 }
 
 /**
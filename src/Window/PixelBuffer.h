@@ -20,7 +20,7 @@ class PixelBuffer
     PixelBuffer(int width, int height);
     ~PixelBuffer();
 
-    void setPixel(int x, int y, Vec3 pixel);
+    void setPixel(int x, int y, Vec3 pixel, unsigned int numRaysShot);
     auto getPixels() -> float *;
 
     void resizeBuffer(int width, int height);
@@ -62,12 +62,10 @@ Window::Window(std::string title, int width, int height) : m_Title(title)
     glfwSetFramebufferSizeCallback(m_Window, [](GLFWwindow *window, int width, int height) {
         auto *data = (WindowData *)glfwGetWindowUserPointer(window);
 
+        // the pixel buffer is resized by the application loop while the render workers are paused
         data->m_FBWidth = width;
         data->m_FBHeight = height;
 
-        data->m_PixelBuffer->resizeBuffer(width, height);
-        data->m_RayTracer->updateAspectRatio((float)width / (float)height);
-
         glViewport(0, 0, width, height);
     });
 }
@@ -123,16 +121,6 @@ void Window::setPixelBuffer(PixelBuffer *pixelBuffer)
     m_Data.m_PixelBuffer = pixelBuffer;
 }
 
-/**
- * sets the ray tracer that will color the pixels of the window
- *
- * \param rayTracer - the ray tracer object that will color the pixels
- */
-void Window::setRayTracer(RayTracer *rayTracer)
-{
-    m_Data.m_RayTracer = rayTracer;
-}
-
 void Window::pollEvents()
 {
     glfwPollEvents();
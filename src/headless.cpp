@@ -0,0 +1,100 @@
+#include "RayTracer/RayTracer.h"
+#include "RayTracer/Renderer.h"
+#include "Scene/Scene.h"
+#include "Utils/Config.h"
+#include "Utils/ImageWriter.h"
+#include "Utils/ThreadPool.h"
+#include "Window/PixelBuffer.h"
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * seconds elapsed since a start time point
+ */
+static auto secondsSince(Clock::time_point start) -> double
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * renders a scene without a window or OpenGL context
+ * every pixel is sampled config.samplesPerPixel times, or until config.timeLimit seconds have passed,
+ * then the image is written to the output path and the timing stats are printed
+ */
+auto main(int argc, char *argv[]) -> int
+{
+    if (argc < 4)
+    {
+        throw std::invalid_argument("Too few arguments! Need config file path, scene file path and output image path.");
+    }
+
+    std::string configPath = std::string(argv[1]);
+    std::string scenePath = std::string(argv[2]);
+    std::string outputPath = std::string(argv[3]);
+
+    // load config file
+    Config config(configPath);
+
+    // the headless image uses the window size from the config
+    PixelBuffer pixelBuffer(config.windowWidth, config.windowHeight);
+
+    // the worker threads load the models, build the BVH and then render
+    ThreadPool threadPool(config.numThreads);
+    const unsigned int numThreads = threadPool.getNumThreads();
+
+    // create scene
+    auto loadStart = Clock::now();
+    Scene scene(scenePath, &threadPool, config.sceneCache);
+    double loadTime = secondsSince(loadStart);
+
+    auto buildStart = Clock::now();
+    scene.createAcceleratedStructure(config.getBVHBuildSettings(), &threadPool);
+    double buildTime = secondsSince(buildStart);
+
+    RayTracer rayTracer(&pixelBuffer, &scene, config);
+
+    const int width = config.windowWidth;
+    const int height = config.windowHeight;
+
+    // one pass gives every pixel one sample
+    Renderer renderer(&rayTracer, &pixelBuffer, &threadPool, config.tileSize, config.samplesPerPixel);
+    renderer.setAdaptiveSampling(config.noiseThreshold, config.minAdaptiveSamples);
+
+    auto renderStart = Clock::now();
+    renderer.start();
+    bool timeUp = !renderer.waitUntilFinished(config.timeLimit);
+    renderer.stop();
+    renderer.resolve();
+    double renderTime = secondsSince(renderStart);
+
+    if (!ImageWriter::write(outputPath, pixelBuffer.getPixels(), width, height))
+    {
+        return EXIT_FAILURE;
+    }
+
+    unsigned int completedPasses = renderer.getCompletedPasses();
+    unsigned long long numSamples = renderer.getNumSamples();
+    double samplesPerSecond = static_cast<double>(numSamples) / renderTime;
+
+    std::cout << "Scene load:        " << loadTime * 1000.0 << " ms" << std::endl;
+    std::cout << "BVH build:         " << buildTime * 1000.0 << " ms" << std::endl;
+    std::cout << "Render:            " << renderTime * 1000.0 << " ms on " << numThreads << " threads" << std::endl;
+    double averageSamples = static_cast<double>(numSamples) / (static_cast<double>(width) * height);
+
+    std::cout << "Samples per pixel: " << completedPasses << " passes of " << config.samplesPerPixel << ", "
+              << averageSamples << " on average" << (timeUp ? " (time limit reached)" : "")
+              << (renderer.isConverged() ? " (converged)" : "") << std::endl;
+    std::cout << "Samples:           " << numSamples << " (" << samplesPerSecond / 1.0e6 << " Msamples/s)" << std::endl;
+    RayCounts rays = renderer.getRayCounts();
+    std::cout << "Path rays:         " << rays.pathRays << " ("
+              << static_cast<double>(rays.pathRays) / static_cast<double>(numSamples) << " per sample)" << std::endl;
+    std::cout << "Shadow rays:       " << rays.shadowRays << " ("
+              << static_cast<double>(rays.shadowRays) / static_cast<double>(numSamples) << " per sample)" << std::endl;
+    std::cout << "Image written to " << outputPath << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -1,17 +1,19 @@
 #include "RayTracer/RayTracer.h"
+#include "RayTracer/Renderer.h"
 #include "Scene/Scene.h"
 #include "Scene/SceneObject.h"
 #include "Utils/Config.h"
 #include "Utils/ObjModel.h"
+#include "Utils/ThreadPool.h"
 #include "Window/PixelBuffer.h"
 #include "Window/Window.h"
 
 #include <algorithm>
+#include <chrono>
 #include <exception>
 #include <functional>
 #include <iostream>
 #include <memory>
-#include <random>
 #include <thread>
 
 auto main(int argc, char *argv[]) -> int
@@ -35,60 +37,48 @@ auto main(int argc, char *argv[]) -> int
     PixelBuffer pixelBuffer(fbSize.first, fbSize.second);
     window.setPixelBuffer(&pixelBuffer);
 
+    // the worker threads are created once, they build the BVH and then keep tracing while frames are presented
+    ThreadPool threadPool(config.numThreads);
+
     // create scene
-    Scene scene(scenePath);
-    scene.createAcceleratedStructure();
+    Scene scene(scenePath, &threadPool, config.sceneCache);
+    scene.createAcceleratedStructure(config.getBVHBuildSettings(), &threadPool);
 
     RayTracer rayTracer(&pixelBuffer, &scene, config);
-    window.setRayTracer(&rayTracer);
 
-    // set up thread safe random number generator [0.0, 1.0)
-    std::default_random_engine randomGenerator;
-    std::uniform_real_distribution<float> dist(0.0, 1.0);
+    Renderer renderer(&rayTracer, &pixelBuffer, &threadPool, config.tileSize);
+    renderer.setAdaptiveSampling(config.noiseThreshold, config.minAdaptiveSamples);
+    renderer.start();
 
-    // set up thread list for ray shooting
-    std::vector<std::thread> threads;
+    auto frameTime = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / static_cast<double>(std::max(config.fps, 1U))));
+    auto nextFrame = std::chrono::steady_clock::now();
 
     // application loop
     while (!window.shouldClose())
     {
         auto curSize = window.getFrameBufferSize();
-        unsigned int curWidth = curSize.first;
-        unsigned int curHeight = curSize.second;
-
-        // initialize threads for ray shooting
-        for (size_t i = 0; i < config.numThreads; i++)
-        {
-            if (curWidth > 0 && curHeight > 0)
-            {
-                threads.emplace_back([&]() {
-                    double curTime = glfwGetTime();
-                    double endingTime = curTime + (1.0F / static_cast<float>(config.fps));
-
-                    // shoot rays until ready to display next frame
-                    while (curTime < endingTime)
-                    {
-                        float x = dist(randomGenerator);
-                        float y = dist(randomGenerator);
-                        rayTracer.sampleScene(x, y);
-                        curTime = glfwGetTime();
-                    }
-                });
-            }
-        }
+        auto bufferSize = pixelBuffer.getSize();
 
-        // wait for all threads to finish
-        for (std::thread &t : threads)
+        // the workers must not sample while the pixel buffer is reallocated
+        if (curSize.first > 0 && curSize.second > 0 && curSize != bufferSize)
         {
-            if (t.joinable())
-            {
-                t.join();
-            }
+            renderer.pause();
+            pixelBuffer.resizeBuffer(curSize.first, curSize.second);
+            rayTracer.updateAspectRatio(static_cast<float>(curSize.first) / static_cast<float>(curSize.second));
+            renderer.restart();
+            renderer.resume();
         }
 
+        renderer.resolve();
         window.update();
+
+        nextFrame += frameTime;
+        std::this_thread::sleep_until(nextFrame);
     }
 
+    renderer.stop();
+
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }